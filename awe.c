@@ -34,6 +34,7 @@ License along with Awe.  If not, see <http://www.gnu.org/licenses/>.
 #include <malloc.h>
 #else
 #include <gc/gc.h>
+#include <gc/gc_typed.h>
 #endif
 
 
@@ -44,6 +45,7 @@ _awe_init (_awe_loc loc)
     _awe_init_awestd();
     _awe_init_exceptions(loc);
     _awe_init_aweio(loc);
+    _awe_init_arrays(loc);
 }
 
 
@@ -161,64 +163,84 @@ _awe_allocate_record(_awe_loc l, int size)
 }
 
 
-int
-_awe_is (void *ref, const char *class)
+void *
+_awe_allocate_record_of_class(_awe_loc l, _awe_record_class_t *class)
 {
-  return ref && _awe_class(ref) == class;  /* i.e. pointer is not NULL and points to record of right class */
+  void *record;
+
+#ifdef NO_GC
+  record = malloc((size_t)class->size);  /* must stay 'free'-able, see awe.txt */
+#else
+  if (class->nreferences == 0)
+    record = GC_MALLOC_ATOMIC((size_t)class->size);
+  else {
+    if (!class->descriptor) {
+      const size_t nwords = (class->size + sizeof(GC_word) - 1) / sizeof(GC_word);
+      GC_word bitmap[nwords / (8 * sizeof(GC_word)) + 1];
+      memset(bitmap, 0, sizeof bitmap);
+      for (int i = 0; i < class->nreferences; ++i)
+        GC_set_bit(bitmap, class->references[i] / sizeof(GC_word));
+      class->descriptor = GC_make_descriptor(bitmap, nwords);
+    }
+    record = GC_MALLOC_EXPLICITLY_TYPED((size_t)class->size, class->descriptor);
+  }
+#endif
+
+  if (record)
+    return record;
+  else
+    _awe_error(l, "Could not allocate record %i: Out of memory!", _awe_record_counter + 1);
 }
 
 
-int _awe_you_should_not_pointing_here;
+struct _awe_any_record _awe_you_should_not_pointing_here = { "uninitialized", 0, -1 };
 
 
 void
-_awe_ref_field_check (_awe_loc loc, void *ref, const char *class, const char *field_name)
+_awe_ref_null_error (_awe_loc loc, void *ref, const char *field_name)
 {
   if (!ref)
     _awe_error(loc, "reference error: tried to find field %s of a NULL reference", field_name);
-  if (ref == _awe_uninitialized_reference)
+  else
     _awe_error(loc, "reference error: tried to find field %s of an uninitialized reference", field_name);
-  if (!_awe_is(ref, class))
-    _awe_error( loc, "reference error: tried to find field %s of a REFERENCE(%s)",
-               field_name,
-               _awe_class(ref) );
+  abort();  /* not reached, '_awe_error' exits */
 }
 
 
-/* Converts a zero-terminated array of record class numbers into the Algol W name for a reference type.  */
-/* This only gets used by the function below. */
-static
-char *
-_awe_string_of_ref (const char **classes)
+void
+_awe_ref_field_error (_awe_loc loc, void *ref, const char *field_name)
 {
-  static char s[512];
-  const char **pclass;
-
-  assert(*classes != 0);
-  strcpy(s, "a REFERENCE(");
-  strcat(s, *classes);
-  for (pclass = classes + 1; *pclass != 0; ++pclass) {
-    strcat(s, ", ");
-    strcat(s, *pclass);
-  }
-  strcat(s, ")");
-  return s;
+  _awe_error( loc, "reference error: tried to find field %s of a REFERENCE(%s)",
+             field_name,
+             _awe_class(ref) );
+  abort();  /* not reached, '_awe_error' exits */
 }
 
 
-void *
-_awe_ref_cast_check (_awe_loc loc, void *ref, const char **classes)
+/* The library copy of the inline function in "awe.h". */
+
+void
+_awe_ref_field_check (_awe_loc loc, void *ref, int class, const char *field_name)
 {
-  const char **pclass;
+  if (!ref || ref == _awe_uninitialized_reference)
+    _awe_ref_null_error(loc, ref, field_name);
+  if (!_awe_is(ref, class))
+    _awe_ref_field_error(loc, ref, field_name);
+}
 
-  if (ref == NULL)
-      return NULL;
-  for (pclass = classes; *pclass != 0; ++pclass)
-    if (_awe_class(ref) == *pclass)
-      return ref;
+
+/* Uninitialized references are passed on unchecked, as they are by
+   assignments that need no cast. */
+
+void *
+_awe_ref_cast_error (_awe_loc loc, void *ref, const char *type_name)
+{
+  if (ref == _awe_uninitialized_reference)
+    return ref;
   _awe_error( loc, "reference error: %s cannot be made to refer to a '%s' record.",
-             _awe_string_of_ref(classes),
+             type_name,
              _awe_class(ref) );
+  abort();  /* not reached, '_awe_error' exits */
 }
 
 
@@ -268,17 +290,26 @@ _awe_case_range_error(_awe_loc l, int selector)
 }
 
 
+/* Integer division by zero: the result is the dividend. */
+
+int
+_awe_div_zero(_awe_loc loc, int dividend)
+{
+  if (intdivzero != NULL)
+    _awe_process_exception(loc, intdivzero);
+  return dividend;
+}
+
+
+/* The library copies of the inline functions in "awe.h". */
+
 int
 _awe_div(_awe_loc loc, int dividend, int  divisor)
 {
   if (divisor != 0)
     return dividend / divisor;
-  else if (intdivzero == NULL)
-    return dividend;
-  else {
-    _awe_process_exception(loc, intdivzero);
-    return dividend;
-  }
+  else
+    return _awe_div_zero(loc, dividend);
 }
 
 
@@ -287,12 +318,8 @@ _awe_rem(_awe_loc loc, int dividend, int  divisor)
 {
   if (divisor != 0)
     return dividend % divisor;
-  else if (intdivzero == NULL)
-    return dividend;
-  else {
-    _awe_process_exception(loc, intdivzero);
-    return dividend;
-  }
+  else
+    return _awe_div_zero(loc, dividend);
 }
 
 
@@ -28,23 +28,31 @@ License along with Awe.  If not, see <http://www.gnu.org/licenses/>.
    so the two will never clash. */
 
 
+/* The fast paths of the busiest library functions are defined here so that they can 
+   be inlined into the generated code. The library has ordinary copies of them, for 
+   external procedures and for compiling without optimization. Their errors are 
+   handled by separate "cold" functions. */
+
+#define _awe_INLINE extern inline __attribute__((gnu_inline))
+
+
 /* Entering and exiting the program, runtime messages. - - - - - - - - - - - - - - - - - - - - - - - - - -  */
 
 
 /* This represents a location in an Algol W source file. */
 /* Every C function that implements an action that can cause a runtime error has an _awe_loc argument. */
 
-typedef struct _awe_LOC {
+typedef const struct _awe_LOC {
   const char *file;
   int line;
   int column;
 } *_awe_loc;
 
 
-/* _awe_src_<nnn> must be a string variable valid at the point of call for this macro to work.
-   The compiler ensures this. */
+/* _awe_locs must be the static table of source locations for this macro to work. 
+   The compiler declares it, so that passing a location is passing a constant address. */
 
-#define _awe_at(filenum, line, column) (&(struct _awe_LOC){_awe_src_##filenum, line, column})
+#define _awe_at(index) (&_awe_locs[index])
 
 
 /* A macro for _awe_loc locations, to be used in C functions that implement external procedures. */
@@ -90,18 +98,30 @@ int _awe_env_bool (_awe_loc l, const char *variable, int default_);
 void *_awe_allocate_record(_awe_loc l, int size);
 
 
-/* The compiler initializes all reference variables to point to this dummy location.
-   Its allows the runtime to tell if a field designator is being called on an
-   uninitialized reference. */
+/* The compiler declares one of these for each record class, and allocates
+   records with '_awe_allocate_record_of_class'. Records of classes with no
+   REFERENCE fields are allocated as memory the garbage collector does not
+   need to scan. Other records are allocated with a type descriptor that
+   tells the collector exactly which words are references, so that REAL
+   and STRING fields that look like pointers do not retain anything. The
+   descriptor is made from 'references' when the first record of the
+   class is allocated. */
 
-extern int _awe_you_should_not_pointing_here;
-#define _awe_uninitialized_reference ((void*)&_awe_you_should_not_pointing_here)
+typedef struct _awe_record_class {
+    int size;                          /* the size of the record structure */
+    int nreferences;                   /* the number of REFERENCE fields */
+    const unsigned long *references;   /* the offsets of the REFERENCE fields */
+    unsigned long descriptor;          /* the collector's type descriptor, 0 until made */
+} _awe_record_class_t;
+
+void *_awe_allocate_record_of_class(_awe_loc l, _awe_record_class_t *class);
 
 
 /* The header of  all Algol records
 
-   Records contain pointers to the names of their record class, which
-   serve as class tags.
+   Records contain pointers to the names of their record class, for
+   messages, and the numbers of their classes, which serve as class
+   tags.
 
    Records are numbered in order of allocation. That information is
    given out with Awe error messages. (Hendrik Boom says this is quite
@@ -114,38 +134,101 @@ extern int _awe_you_should_not_pointing_here;
 struct _awe_any_record {
     const char *_class;
     int _number;
+    int _class_number;
 };
 
 #define _awe_class(ref)         (((struct _awe_any_record *)ref)->_class)
 #define _awe_record_number(ref) (((struct _awe_any_record *)ref)->_number)
+#define _awe_class_number(ref)  (((struct _awe_any_record *)ref)->_class_number)
 
 extern int _awe_record_counter;  /* for numbering records */
 
+
+/* The compiler initializes all reference variables to point to this dummy record.
+   Its allows the runtime to tell if a field designator is being called on an
+   uninitialized reference. Its class number is -1, which belongs to no class. */
+
+extern struct _awe_any_record _awe_you_should_not_pointing_here;
+#define _awe_uninitialized_reference ((void*)&_awe_you_should_not_pointing_here)
+
+
 /* '_awe_ref_cast' is used in some reference assignments and actual parameters.
    It returns a reference if it refers to a record that belongs in a set of classes,
    otherwise it raises a run-time reference type error.
    This is only called in places where such an error is possible.
-   'classes' is NULL-terminated array of pointers to class names. */
-
-#define _awe_ref_cast(loc, reference, classes...) (_awe_ref_cast_check(loc, reference, (const char *[]){classes, (const char *)0}))
-void *_awe_ref_cast_check (_awe_loc loc, void *reference, const char **classes);
+   'mask' has a bit set for the number of each class in the set. Sets with classes
+   numbered 64 or more use '_awe_ref_cast_set', with a mask of 'nwords' words.
+   'type_name' is the Algol name of the reference type, for the error message. */
+
+void *_awe_ref_cast_error (_awe_loc loc, void *reference, const char *type_name) __attribute__((cold));
+
+static inline void *
+_awe_ref_cast (_awe_loc loc, void *reference, unsigned long long mask, const char *type_name)
+{
+    if (reference) {
+        const unsigned n = _awe_class_number(reference);
+        if (__builtin_expect(n >= 64 || !((mask >> n) & 1), 0))
+            return _awe_ref_cast_error(loc, reference, type_name);
+    }
+    return reference;
+}
+
+static inline void *
+_awe_ref_cast_set (_awe_loc loc, void *reference, const unsigned long long *mask, unsigned nwords, const char *type_name)
+{
+    if (reference) {
+        const unsigned n = _awe_class_number(reference);
+        if (__builtin_expect(n / 64 >= nwords || !((mask[n / 64] >> (n % 64)) & 1), 0))
+            return _awe_ref_cast_error(loc, reference, type_name);
+    }
+    return reference;
+}
 
 /* This is used in field designator functions; it raises a run-time
-   reference type error if 'reference' does not belong in 'class'. */
-
-void _awe_ref_field_check (_awe_loc loc, void *reference, const char *class, const char *field_name);
+   reference type error if 'reference' does not belong in class number 'class'. */
+
+void _awe_ref_null_error (_awe_loc loc, void *reference, const char *field_name) __attribute__((cold, noreturn));
+void _awe_ref_field_error (_awe_loc loc, void *reference, const char *field_name) __attribute__((cold, noreturn));
+
+_awe_INLINE void
+_awe_ref_field_check (_awe_loc loc, void *reference, int class, const char *field_name)
+{
+    if (__builtin_expect(!reference || reference == _awe_uninitialized_reference, 0))
+        _awe_ref_null_error(loc, reference, field_name);
+    if (__builtin_expect(_awe_class_number(reference) != class, 0))
+        _awe_ref_field_error(loc, reference, field_name);
+}
+
+/* This is used in place of '_awe_ref_field_check' where 'reference' can only belong
+   in the field's class. It raises the run-time reference error if 'reference' is
+   NULL or uninitialized, otherwise it returns 'reference'. */
+
+static inline void *
+_awe_ref_not_null (_awe_loc loc, void *reference, const char *field_name)
+{
+    if (__builtin_expect(!reference || reference == _awe_uninitialized_reference, 0))
+        _awe_ref_null_error(loc, reference, field_name);
+    return reference;
+}
 
 /* The IS operator. */
 
-int _awe_is (void *ref, const char *class);
+static inline int
+_awe_is (void *ref, int class)
+{
+    return ref && _awe_class_number(ref) == class;  /* i.e. pointer is not NULL and points to record of right class */
+}
 
 
 
 /* Arrays. - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 /* Array descriptors represent multidimensional arrays with non-zero
-   lower bounds, and slices taken from such arrays. Arrays and their
-   'descriptors' are allocated on the stack.
+   lower bounds, and slices taken from such arrays. Array descriptors
+   are allocated on the stack. The elements of small arrays are also
+   allocated on the stack, larger arrays have their elements allocated
+   from the heap, and huge arrays are given memory-mapped pages. (See
+   '_awe_array_allocate'.)
 
    See 'Modern Compiler Design' by Grune, Bal, Jacobs and Langendoen
    for the approach taken here.
@@ -164,11 +247,15 @@ typedef struct _awe_array {
     long  total_offset;  /* total of offsets to element at 0 in all dimensions */
     long *multipliers;   /* number of bytes between each subscript of a dimension */
     _awe_array_bound_t *bounds;        /* bounds of each dimension */
+    int   storage;       /* where element_data was allocated, see below */
 } _awe_array_t;
 
 /* Note that for subarrays element_data and nelements are the same as
    for the base array */
 
+/* Values of 'storage'. Subarrays borrow their element data. */
+enum { _awe_array_BORROWED, _awe_array_ON_STACK, _awe_array_ON_HEAP, _awe_array_MAPPED };
+
 
 typedef struct _awe_array_slicer {
     _Bool slice;     /* slice along this dimension? */
@@ -206,9 +293,189 @@ _awe_array_element_pointer ( _awe_loc loc,
     (type*)_awe_array_element_pointer((loc), (array), (int[]){subscripts})
 
 
-/* declare an array on the stack. */
-#define _awe_array_DECLARE(loc, array, elementsize, ndimensions, bounds_array) \
-    _awe_array_t _##array##_descriptor;                                 \
+/* Raises the run-time error for a subscript outside the bounds of a dimension.
+   'dimension' counts from 0. */
+
+void
+_awe_array_subscript_error ( _awe_loc loc,
+                             int dimension,
+                             int subscript,
+                             const _awe_array_bound_t *bound )
+    __attribute__((cold, noreturn));
+
+
+/* Rank-specialized versions of '_awe_array_element_pointer' for arrays
+   of 1, 2 and 3 dimensions. The compiler uses these for all arrays of
+   those ranks. They are inline so that the bounds checks and the
+   multiply-adds are unrolled into the generated code, without a
+   temporary array of subscripts. */
+
+static inline long
+_awe_array_offset (_awe_loc loc, const _awe_array_t *array, int dimension, int subscript)
+{
+    const _awe_array_bound_t *bound = &array->bounds[dimension];
+    if (__builtin_expect(subscript < bound->lower || subscript > bound->upper, 0))
+        _awe_array_subscript_error(loc, dimension, subscript, bound);
+    return subscript * array->multipliers[dimension];
+}
+
+static inline void *
+_awe_array_element_pointer_1 (_awe_loc loc, const _awe_array_t *array, int s1)
+{
+    return (char*)(array->element_data) - array->total_offset
+           + _awe_array_offset(loc, array, 0, s1);
+}
+
+static inline void *
+_awe_array_element_pointer_2 (_awe_loc loc, const _awe_array_t *array, int s1, int s2)
+{
+    return (char*)(array->element_data) - array->total_offset
+           + _awe_array_offset(loc, array, 0, s1)
+           + _awe_array_offset(loc, array, 1, s2);
+}
+
+static inline void *
+_awe_array_element_pointer_3 (_awe_loc loc, const _awe_array_t *array, int s1, int s2, int s3)
+{
+    return (char*)(array->element_data) - array->total_offset
+           + _awe_array_offset(loc, array, 0, s1)
+           + _awe_array_offset(loc, array, 1, s2)
+           + _awe_array_offset(loc, array, 2, s3);
+}
+
+#define _awe_array_SUB1(loc, type, array, s1)                           \
+    ((type*)_awe_array_element_pointer_1((loc), (array), (s1)))
+
+#define _awe_array_SUB2(loc, type, array, s1, s2)                       \
+    ((type*)_awe_array_element_pointer_2((loc), (array), (s1), (s2)))
+
+#define _awe_array_SUB3(loc, type, array, s1, s2, s3)                   \
+    ((type*)_awe_array_element_pointer_3((loc), (array), (s1), (s2), (s3)))
+
+
+/* Subscripts of FOR loop control identifiers can be checked once, for
+   the whole range of the loop, before the loop starts. This is true if
+   all of the subscripts 'first' to 'last' are within the bounds of a
+   dimension. */
+
+#define _awe_array_IN_RANGE(array, dimension, first, last)              \
+    ((first) >= (array)->bounds[dimension].lower && (last) <= (array)->bounds[dimension].upper)
+
+
+/* Versions of the above with a flag before each subscript. A subscript's
+   bounds are not checked if its flag is true. The flags are the results
+   of _awe_array_IN_RANGE, or 0. */
+
+static inline long
+_awe_array_hoisted_offset (_awe_loc loc, const _awe_array_t *array, int dimension, int in_range, int subscript)
+{
+    if (in_range)
+        return subscript * array->multipliers[dimension];
+    else
+        return _awe_array_offset(loc, array, dimension, subscript);
+}
+
+static inline void *
+_awe_array_hoisted_pointer_1 (_awe_loc loc, const _awe_array_t *array, int f1, int s1)
+{
+    return (char*)(array->element_data) - array->total_offset
+           + _awe_array_hoisted_offset(loc, array, 0, f1, s1);
+}
+
+static inline void *
+_awe_array_hoisted_pointer_2 (_awe_loc loc, const _awe_array_t *array, int f1, int s1, int f2, int s2)
+{
+    return (char*)(array->element_data) - array->total_offset
+           + _awe_array_hoisted_offset(loc, array, 0, f1, s1)
+           + _awe_array_hoisted_offset(loc, array, 1, f2, s2);
+}
+
+static inline void *
+_awe_array_hoisted_pointer_3 (_awe_loc loc, const _awe_array_t *array, int f1, int s1, int f2, int s2, int f3, int s3)
+{
+    return (char*)(array->element_data) - array->total_offset
+           + _awe_array_hoisted_offset(loc, array, 0, f1, s1)
+           + _awe_array_hoisted_offset(loc, array, 1, f2, s2)
+           + _awe_array_hoisted_offset(loc, array, 2, f3, s3);
+}
+
+#define _awe_array_HOISTED_SUB1(loc, type, array, f1, s1)               \
+    ((type*)_awe_array_hoisted_pointer_1((loc), (array), (f1), (s1)))
+
+#define _awe_array_HOISTED_SUB2(loc, type, array, f1, s1, f2, s2)       \
+    ((type*)_awe_array_hoisted_pointer_2((loc), (array), (f1), (s1), (f2), (s2)))
+
+#define _awe_array_HOISTED_SUB3(loc, type, array, f1, s1, f2, s2, f3, s3) \
+    ((type*)_awe_array_hoisted_pointer_3((loc), (array), (f1), (s1), (f2), (s2), (f3), (s3)))
+
+
+/* Arrays whose bounds are all integer constants have constant strides,
+   and the compiler indexes their elements directly, without going
+   through the descriptor. Each subscript is passed through
+   '_awe_array_fixed_subscript', which checks it against the constant
+   bounds of its dimension unless its hoisted flag is true. 'index' is
+   the number of elements from the start of the element data. */
+
+static inline int
+_awe_array_fixed_subscript (_awe_loc loc, int dimension, int in_range, int subscript, int lower, int upper)
+{
+    if (!in_range && __builtin_expect(subscript < lower || subscript > upper, 0))
+        _awe_array_subscript_error(loc, dimension, subscript, &(const _awe_array_bound_t){lower, upper});
+    return subscript;
+}
+
+#define _awe_array_FIXED_IN_RANGE(first, last, lower, upper)            \
+    ((first) >= (lower) && (last) <= (upper))
+
+#define _awe_array_FIXED_SUB(type, array, elementsize, index)           \
+    ((type*)(_##array##_data + (long)(elementsize) * (index)))
+
+
+/* Arrays whose elements take more bytes than this are not allocated
+   on the stack. Without a garbage collector, arrays whose elements
+   take more bytes than the mapping limit are given their own
+   memory-mapped pages. These are set by the environment variables
+   AWE_ARRAY_STACK_LIMIT and AWE_ARRAY_MMAP_LIMIT. */
+
+extern long _awe_array_stack_limit;
+extern long _awe_array_mmap_limit;
+
+void _awe_init_arrays (_awe_loc loc);
+
+
+/* Returns the number of bytes of stack the elements of 'array' should have,
+   1 if they should be allocated elsewhere or there are none, because a
+   C array cannot have 0 elements. */
+
+static inline long
+_awe_array_stack_bytes (const _awe_array_t *array)
+{
+    const long bytes = array->nelements * array->element_size;
+    return bytes > 0 && bytes <= _awe_array_stack_limit ? bytes : 1;
+}
+
+
+/* Sets 'array->element_data'. Uses 'stack_data' if the array is small
+   enough, otherwise allocates the elements. 'pointers' is true if the
+   elements are references, which the garbage collector must scan. */
+
+void
+_awe_array_allocate ( _awe_loc loc,
+                      _awe_array_t *array,
+                      void *stack_data,
+                      int pointers );
+
+
+/* Releases the storage of an array's elements when its block exits.
+   Arrays are declared with this as a 'cleanup' function. */
+
+void _awe_array_release (_awe_array_t *array);
+
+
+/* declare an array and its descriptor. */
+#define _awe_array_DECLARE(loc, array, elementsize, ndimensions, bounds_array, pointers) \
+    _awe_array_t _##array##_descriptor                                  \
+        __attribute__((cleanup(_awe_array_release))) = {0};             \
     _awe_array_t *array = &_##array##_descriptor;                       \
                                                                         \
     const int _##array##_ndimensions = (ndimensions);                   \
@@ -221,9 +488,27 @@ _awe_array_element_pointer ( _awe_loc loc,
                            _##array##_multipliers,                      \
                            (elementsize) );                             \
                                                                         \
-    char _##array##_element_data [array->nelements * array->element_size]; \
-    array->element_data = _##array##_element_data;                      \
-
+    char _##array##_element_data [_awe_array_stack_bytes(array)];       \
+    _awe_array_allocate((loc), array, _##array##_element_data, (pointers));
+
+
+
+/* declare an array with constant bounds. Its descriptor is a constant
+   initializer, it is only needed if the array is passed to an ARRAY
+   formal, subarrayed or filled. '_array_data' is the element data that
+   '_awe_array_FIXED_SUB' indexes. */
+#define _awe_array_DECLARE_FIXED(loc, array, elementsize, ndimensions, bounds_array, pointers, nelements, offset, multipliers...) \
+    long _##array##_multipliers [] = {multipliers};                     \
+    _awe_array_t _##array##_descriptor                                  \
+        __attribute__((cleanup(_awe_array_release))) =                  \
+        { 0, (nelements), (elementsize), (ndimensions),                 \
+          (long)(offset) * (elementsize), _##array##_multipliers,       \
+          (bounds_array), _awe_array_BORROWED };                        \
+    _awe_array_t *array = &_##array##_descriptor;                       \
+                                                                        \
+    char _##array##_element_data [_awe_array_stack_bytes(array)];       \
+    _awe_array_allocate((loc), array, _##array##_element_data, (pointers)); \
+    char *const _##array##_data = array->element_data;
 
 
 /* declare a subarray on the stack */
@@ -245,13 +530,26 @@ _awe_array_element_pointer ( _awe_loc loc,
                               _##subarray##_multipliers )
 
 
+/* Fills 'nelements' elements of 'element_size' bytes at 'data' with
+   copies of the element at 'pattern'. Patterns of one repeated byte
+   become a 'memset', patterns of 4, 8 and 16 bytes are stored 16 bytes
+   at a time, other sizes are filled by doubling copies. */
+
+void _awe_fill (void *data, long nelements, long element_size, const void *pattern);
+
+
+/* Initializes the elements of a newly declared array to the element
+   at 'pattern'. Zero fills are skipped when the element data is
+   known to be fresh zeroed pages (See '_awe_array_allocate'.) */
+
+void _awe_array_fill (_awe_array_t *array, const void *pattern);
+
+
 #define _awe_array_FILL(element_type, array, filler)                   \
-    for (int i = 0; i < array->nelements; ++i)                         \
-        ((element_type*)(array->element_data))[i] = (filler)
+    _awe_array_fill((array), &(element_type){filler})
 
 #define _awe_array_FILL_WITH_SPACES(array)                              \
-    for (int i = 0; i < array->nelements * array->element_size; ++i)    \
-        ((char*)(array->element_data))[i] = ' '
+    _awe_fill((array)->element_data, (array)->nelements * (array)->element_size, 1, " ")
 
 /* Statements. - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -271,6 +569,20 @@ void _awe_check_for_step(_awe_loc l, int for_step);
 void _awe_case_range_error(_awe_loc l, int selector);
 
 
+/* Name parameters. - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Name parameters are normally pointers to nested "thunk" functions, which GCC must call
+   through trampolines built on the stack. With the compiler's -n option they are passed
+   as closures instead: a thunk function and a pointer to the caller's variables. */
+
+typedef struct _awe_name {
+  void *(*code)(void *env);  /* returns a pointer to the parameter's value */
+  void *env;
+} _awe_name;
+
+#define _awe_NAME(pointer_type, name) ((pointer_type)(name).code((name).env))
+
+
 
 /* Arithmetic. - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -287,8 +599,24 @@ void _awe_case_range_error(_awe_loc l, int selector);
 
 /* Divide-by-zero is a runtime error. */
 
-int _awe_div(_awe_loc l, int a, int b);
-int _awe_rem(_awe_loc l, int a, int b);
+int _awe_div_zero(_awe_loc l, int a) __attribute__((cold));
+
+_awe_INLINE int
+_awe_div(_awe_loc l, int a, int b)
+{
+    if (__builtin_expect(b == 0, 0))
+        return _awe_div_zero(l, a);
+    return a / b;
+}
+
+_awe_INLINE int
+_awe_rem(_awe_loc l, int a, int b)
+{
+    if (__builtin_expect(b == 0, 0))
+        return _awe_div_zero(l, a);
+    return a % b;
+}
+
 double _awe_rdiv(_awe_loc loc, double dividend, double divisor);
 _Complex double _awe_cdiv(_awe_loc loc, _Complex double dividend, _Complex double divisor);
 
@@ -347,6 +675,16 @@ _awe_str _awe_string (_awe_str src, int srclen);
 _awe_str _awe_str_cast (_awe_str src, int srclen, int dstlen);
 _awe_str _awe_str_cast_c (unsigned char src, int length);
 
+/* Copy a string into 'dst', the destination a string procedure was given, and return 'dst'. */
+
+static inline _awe_str
+_awe_string_into (_awe_str dst, const _awe_str src, int srclen)
+{
+    if (src != dst)
+        __builtin_memmove(dst, src, srclen);
+    return dst;
+}
+
 
 /* These two are not used by the Algol W runtime, they are use in for external C functions. */
 /* "Unpadded" means "excluding the spaces on the righthand side". */
@@ -359,21 +697,48 @@ int _awe_str_unpadded_length (const _awe_str src, int srclen);
 void _awe_str_unpadded_copy (char * dst, const _awe_str src, int srclen);
 
 
-/* Perform 'dst := src', return 'src': */
+/* Perform 'dst := src', return 'src'. The string is padded with spaces by '_awe_fill'. */
+
+_awe_INLINE _awe_str
+_awe_str_cpy (_awe_str dst, int dstlen, const _awe_str src, int srclen)
+{
+    __builtin_memcpy(dst, src, srclen);
+    if (srclen < dstlen)
+        _awe_fill(dst + srclen, dstlen - srclen, 1, " ");
+    return src;
+}
 
-_awe_str _awe_str_cpy (_awe_str dst, int dstlen, const _awe_str src, int srclen);
 unsigned char _awe_str_cpy_sc (_awe_str dst, int dstlen, unsigned char src);
 
 
 /* Return a pointer to the substring 'src(index|len)'.
    There is a runtime error if the substring is not completely in the bounds of the string. */
 
-_awe_str _awe_str_sub (_awe_loc loc, const _awe_str src, int srclen, int index, int length);
+void _awe_str_sub_error (_awe_loc loc, int srclen, int index, int length) __attribute__((cold, noreturn));
+
+_awe_INLINE _awe_str
+_awe_str_sub (_awe_loc loc, const _awe_str src, int srclen, int index, int length)
+{
+    if (__builtin_expect(index < 0 || length <= 0 || index + length > srclen, 0))
+        _awe_str_sub_error(loc, srclen, index, length);
+    return src + index;
+}
 
 
 /* Compare two strings.  Spaces at the ends of strings are ignored. */
 
-int _awe_str_cmp (const _awe_str str1, int str1len, const _awe_str str2, int str2len);
+/* '_awe_str_collate' does the work, '_awe_str_cmp' first tries the common case 
+   of equal strings of the same length. */
+
+int _awe_str_collate (const _awe_str str1, int str1len, const _awe_str str2, int str2len);
+
+_awe_INLINE int
+_awe_str_cmp (const _awe_str str1, int str1len, const _awe_str str2, int str2len)
+{
+    if (str1len == str2len && __builtin_memcmp(str1, str2, str1len) == 0)
+        return 0;
+    return _awe_str_collate(str1, str1len, str2, str2len);
+}
 int _awe_str_cmp_cs (unsigned char c1, const _awe_str str2, int str2len);
 int _awe_str_cmp_sc (const _awe_str str1, int str1len, unsigned char c2);
 int _awe_str_cmp_cc (unsigned char c1, unsigned char c2);
@@ -552,6 +917,36 @@ void _awe_write_string       (_awe_loc l, _awe_str s, int length);
 void _awe_write_char         (_awe_loc l, unsigned char c);
 void _awe_write_reference    (_awe_loc loc, void *ref);
 
+/* Actions for all the actual parameters of a WRITE or WRITEON statement, in one call, when
+   they are constants or simple variables, which cannot fail or change the editing variables.
+   'fields' is a static array describing the 'count' fields: 'kind' is 'i' for INTEGER, 'r'
+   for (LONG) REAL, 'z' for (LONG) COMPLEX, 'l' for LOGICAL, 'b' for BITS, 'c' for STRING(1),
+   's' for STRING('length') or 'p' for REFERENCE. 'values' holds the values of the fields. 
+   'new_line' is true for WRITE. */
+
+typedef struct {
+    char kind;
+    int length;
+} _awe_Write_field_t;
+
+typedef union {
+    int i;
+    double r;
+    _Complex double z;
+    unsigned int b;
+    unsigned char c;
+    _awe_str s;
+    void *ref;
+} _awe_Write_value_t;
+
+void _awe_write_fields (_awe_loc l, int new_line, int count, 
+                        const _awe_Write_field_t *fields, const _awe_Write_value_t *values);
+
+/* The printers keep each line in a buffer until it is complete. This writes out the partial 
+   lines, it is called before external procedures, which may write to the same streams. */
+
+void _awe_flush_printers (void);
+
 
 /* Actions for READ, READON and READCARD actual parameters. */
 
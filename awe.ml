@@ -162,7 +162,9 @@ let command_line () : string list * operation_t * string =
       ("-c", Arg.String (target Intermediate),  " object.c   Compile to a C intermediate file.");
       ("-p", Arg.String (target Procedure),     " object.c   Separately compile a single Algol procedure.");
       ("-i", Arg.Set Options.initialize_all,    " Initialize all variables.");
-      ("-t", Arg.Set Options.add_tracing_hooks, " Add tracing hooks.") ]
+      ("-t", Arg.Set Options.add_tracing_hooks, " Add tracing hooks.");
+      ("-n", Arg.Set Options.name_closures,     " Pass name parameters as closures, not nested functions.");
+      ("-O", Arg.Set Options.inline_procedures, " Inline calls to small procedures.") ]
   in
 
   try
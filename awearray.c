@@ -22,6 +22,36 @@ License along with Awe.  If not, see <http://www.gnu.org/licenses/>.
 #include "awe.h"  /* See the "Arrays." section for the documentation */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#ifdef NO_GC
+#include <malloc.h>
+#else
+#include <gc/gc.h>
+#endif
+
+#include <sys/mman.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/* The defaults keep stack frames under 64 KiB per array,
+   and give arrays over 32 MiB their own pages. */
+
+long _awe_array_stack_limit = 64 * 1024;
+long _awe_array_mmap_limit = 32 * 1024 * 1024;
+
+
+void
+_awe_init_arrays (_awe_loc loc)
+{
+    _awe_array_stack_limit = _awe_env_int(loc, "AWE_ARRAY_STACK_LIMIT", _awe_array_stack_limit, 0, INT_MAX);
+    _awe_array_mmap_limit = _awe_env_int(loc, "AWE_ARRAY_MMAP_LIMIT", _awe_array_mmap_limit, 0, INT_MAX);
+}
 
 void
 _awe_array_initialize ( _awe_loc loc,
@@ -76,6 +106,7 @@ _awe_subarray_initialize ( _awe_loc loc,
 {
     /* the subarray shares the array's data */
     subarray->element_data = array->element_data;
+    subarray->storage = _awe_array_BORROWED;
     subarray->element_size = array->element_size;
     subarray->bounds = bounds;
     subarray->multipliers = multipliers;
@@ -107,6 +138,151 @@ _awe_subarray_initialize ( _awe_loc loc,
 }
 
 
+void
+_awe_array_allocate ( _awe_loc loc,
+                      _awe_array_t *array,
+                      void *stack_data,
+                      int pointers )
+{
+    const long bytes = array->nelements * array->element_size;
+
+    if (bytes <= _awe_array_stack_limit) {
+        array->element_data = stack_data;
+        array->storage = _awe_array_ON_STACK;
+        return;
+    }
+
+    /* Without a garbage collector, very large arrays are given their own
+       pages, which the kernel zeroes lazily. With one, they come from the
+       collector like other heap arrays, so that it reclaims them even if
+       '_awe_array_release' is never called. */
+#ifdef NO_GC
+    if (bytes > _awe_array_mmap_limit) {
+        void *data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(data, bytes, MADV_HUGEPAGE);
+#endif
+            array->element_data = data;
+            array->storage = _awe_array_MAPPED;
+            return;
+        }
+    }
+#endif
+
+    /* 'calloc' takes large blocks from fresh pages without clearing
+       them, and lets '_awe_array_fill' skip zero fills. */
+#ifdef NO_GC
+    array->element_data = calloc(1, bytes);
+#else
+    array->element_data = pointers ? GC_MALLOC(bytes) : GC_MALLOC_ATOMIC(bytes);
+#endif
+    if (!array->element_data)
+        _awe_error(loc, "array allocation error: cannot allocate %ld bytes", bytes);
+    array->storage = _awe_array_ON_HEAP;
+}
+
+
+/* Note that this is not called if a block is left by a GOTO out of a
+   procedure. Heap storage is then left to the garbage collector; without
+   one, heap storage and mapped pages are lost (see awe.txt). */
+
+void
+_awe_array_release (_awe_array_t *array)
+{
+    switch (array->storage) {
+    case _awe_array_ON_HEAP:
+#ifdef NO_GC
+        free(array->element_data);
+#else
+        GC_FREE(array->element_data);
+#endif
+        break;
+    case _awe_array_MAPPED:
+        munmap(array->element_data, array->nelements * array->element_size);
+        break;
+    }
+    array->storage = _awe_array_BORROWED;
+}
+
+
+/* Filling arrays - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+
+/* Stores 'nbytes' bytes of copies of the 16 byte block at 'block'. */
+
+static void
+fill16 (char *data, long nbytes, const char *block)
+{
+    long i = 0;
+#ifdef __SSE2__
+    const __m128i v = _mm_loadu_si128((const __m128i *)block);
+    for (; i + 64 <= nbytes; i += 64) {
+        _mm_storeu_si128((__m128i *)(data + i),      v);
+        _mm_storeu_si128((__m128i *)(data + i + 16), v);
+        _mm_storeu_si128((__m128i *)(data + i + 32), v);
+        _mm_storeu_si128((__m128i *)(data + i + 48), v);
+    }
+#endif
+    for (; i + 16 <= nbytes; i += 16)
+        memcpy(data + i, block, 16);
+    memcpy(data + i, block, nbytes - i);
+}
+
+
+void
+_awe_fill (void *data, long nelements, long element_size, const void *pattern)
+{
+    const long nbytes = nelements * element_size;
+    const unsigned char *p = pattern;
+    char block[16];
+    long i;
+
+    if (nbytes <= 0)
+        return;
+
+    for (i = 1; i < element_size && p[i] == p[0]; ++i)
+        ;
+    if (i == element_size) {
+        memset(data, p[0], nbytes);
+        return;
+    }
+
+    switch (element_size) {
+    case 4: case 8: case 16:
+        for (i = 0; i < 16; i += element_size)
+            memcpy(block + i, pattern, element_size);
+        fill16(data, nbytes, block);
+        return;
+    }
+
+    /* Each copy doubles the filled part. */
+    memcpy(data, pattern, element_size);
+    for (i = element_size; i < nbytes; i *= 2)
+        memcpy((char *)data + i, data, i <= nbytes - i ? i : nbytes - i);
+}
+
+
+void
+_awe_array_fill (_awe_array_t *array, const void *pattern)
+{
+    const unsigned char *p = pattern;
+    long i;
+
+    for (i = 0; i < array->element_size && p[i] == 0; ++i)
+        ;
+    if (i == array->element_size) {
+#ifdef NO_GC
+        if (array->storage == _awe_array_ON_HEAP)
+            return;
+#endif
+        if (array->storage == _awe_array_MAPPED)
+            return;
+    }
+    _awe_fill(array->element_data, array->nelements, array->element_size, pattern);
+}
+
+
 void *
 _awe_array_element_pointer ( _awe_loc loc,
                              const _awe_array_t *array,
@@ -116,8 +292,7 @@ _awe_array_element_pointer ( _awe_loc loc,
     for (int i = 0; i < array->ndimensions; ++i) {
 
         if (subscripts[i] < array->bounds[i].lower || subscripts[i] > array->bounds[i].upper)
-            _awe_error(loc, "array subscript error: subscript %d = %d, outside the range (%d::%d)",
-                       i + 1, subscripts[i], array->bounds[i].lower, array->bounds[i].upper);
+            _awe_array_subscript_error(loc, i, subscripts[i], &array->bounds[i]);
 
         offset += subscripts[i] * array->multipliers[i];
     }
@@ -125,4 +300,16 @@ _awe_array_element_pointer ( _awe_loc loc,
 }
 
 
+void
+_awe_array_subscript_error ( _awe_loc loc,
+                             int dimension,
+                             int subscript,
+                             const _awe_array_bound_t *bound )
+{
+    _awe_error(loc, "array subscript error: subscript %d = %d, outside the range (%d::%d)",
+               dimension + 1, subscript, bound->lower, bound->upper);
+    abort();  /* not reached, '_awe_error' exits */
+}
+
+
 /* end */
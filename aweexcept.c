@@ -34,6 +34,7 @@ void *endfile;
 struct exception {     /* This is a RECORD structure. */
   const char *_class;
   int _number;
+  int _class_number;
   int xcpnoted;
   int xcplimit;
   int xcpaction;
@@ -55,6 +56,7 @@ exception ( _awe_loc loc,
   struct exception *ref = (struct exception *)_awe_allocate_record(loc, sizeof(struct exception));
   ref->_class = _awe_class_0_exception;
   ref->_number = _awe_record_counter++;
+  ref->_class_number = 0;
   ref->xcpnoted = xcpnoted;
   ref->xcplimit = xcplimit;
   ref->xcpaction = xcpaction;
@@ -66,7 +68,7 @@ exception ( _awe_loc loc,
 int *
 xcpnoted (_awe_loc loc, void *ref) 
 {
-  _awe_ref_field_check(loc, ref, _awe_class_0_exception, "xcpnoted");
+  _awe_ref_field_check(loc, ref, 0, "xcpnoted");
   return &((struct exception *)ref)->xcpnoted;
 }
 
@@ -74,7 +76,7 @@ xcpnoted (_awe_loc loc, void *ref)
 int *
 xcplimit (_awe_loc loc, void *ref)
 {
-  _awe_ref_field_check(loc, ref, _awe_class_0_exception, "xcplimit");
+  _awe_ref_field_check(loc, ref, 0, "xcplimit");
   return &((struct exception *)ref)->xcplimit;
 }
 
@@ -82,7 +84,7 @@ xcplimit (_awe_loc loc, void *ref)
 int *
 xcpaction (_awe_loc loc, void *ref) 
 {
-  _awe_ref_field_check(loc, ref, _awe_class_0_exception, "xcpaction");
+  _awe_ref_field_check(loc, ref, 0, "xcpaction");
   return &((struct exception *)ref)->xcpaction;
 }
 
@@ -90,7 +92,7 @@ xcpaction (_awe_loc loc, void *ref)
 int *
 xcpmark (_awe_loc loc, void *ref) 
 {
-  _awe_ref_field_check(loc, ref, _awe_class_0_exception, "xcpmark");
+  _awe_ref_field_check(loc, ref, 0, "xcpmark");
   return &((struct exception *)ref)->xcpmark;
 }
 
@@ -98,7 +100,7 @@ xcpmark (_awe_loc loc, void *ref)
 _awe_str
 xcpmsg (_awe_loc loc, void *ref) 
 {
-  _awe_ref_field_check(loc, ref, _awe_class_0_exception, "xcpmsg");
+  _awe_ref_field_check(loc, ref, 0, "xcpmsg");
   return ((struct exception *)ref)->xcpmsg;
 }
 
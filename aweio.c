@@ -1,7 +1,9 @@
 /* aweio.c -- primitives for the Algol W "Input/Output System"  -*-C-*-
 
 This file requires "scanner.inc", which is the switch branches of a 
-state machine for scanning input. "scanner.inc" is generated by "scanner.py".
+state machine for scanning input, and "scanner-loops.inc", which has
+tables of the characters that the states loop on. Both are generated
+by "scanner.py".
 
 --
 
@@ -33,7 +35,11 @@ License along with Awe.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdbool.h>
 #include <limits.h>
 #include <complex.h>
-#include <fenv.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 
 /* READING  -------------------------------------------------------------------------------- */
@@ -54,8 +60,104 @@ _awe_Scanner_initialize (_awe_Scanner *scanner, FILE *file, char *input_name)
   scanner->eof = false;
   scanner->state = 0;
   scanner->line = 1;
-  scanner->column = 0;
   scanner->buflen = 0;
+  scanner->base = scanner->next = scanner->end = scanner->counted = NULL;
+  scanner->carry = '\n';
+  scanner->block = NULL;
+  scanner->mapping = NULL;
+  scanner->mapping_size = 0;
+}
+
+
+/* The number of the line that the scanner is reading. */
+
+static
+int
+Scanner_line (_awe_Scanner *scanner)
+{
+  const unsigned char *p;
+
+  while (scanner->counted < scanner->next &&
+         (p = memchr(scanner->counted, '\n', scanner->next - scanner->counted)) != NULL) {
+    ++scanner->line;
+    scanner->counted = p + 1;
+  }
+  scanner->counted = scanner->next;
+  return scanner->eof ? scanner->line + 1 : scanner->line;
+}
+
+
+static void Printer_flush_all (void);
+
+
+/* This is the only function that gets input for a scanner. A regular file is mapped into
+   memory on the first call, other input is read in blocks of whatever is available, so 
+   that a terminal or pipe does not have to fill a block before the scanner sees a line.
+   It returns false at the end of the input, a read error is a runtime error. */
+
+static
+bool
+Scanner_fill (_awe_Scanner *scanner)
+{
+  const unsigned char *p;
+  struct iovec iov;
+  ssize_t n;
+
+  if (scanner->mapping)
+    return false;
+
+  (void)Scanner_line(scanner);
+  for (p = scanner->end; p > scanner->base && p[-1] == '\r'; --p)
+    ;
+  if (p > scanner->base) 
+    scanner->carry = p[-1];
+
+  if (!scanner->block) {
+    struct stat st;
+    const int fd = fileno(scanner->input);
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && ftello(scanner->input) == 0) {
+      void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m != MAP_FAILED) {
+        (void)madvise(m, st.st_size, MADV_SEQUENTIAL);
+        scanner->mapping = m;
+        scanner->mapping_size = st.st_size;
+        scanner->base = scanner->next = scanner->counted = m;
+        scanner->end = scanner->base + st.st_size;
+        return true;
+      }
+    }
+    scanner->block = malloc(Scanner_BLOCKSIZE);
+    if (!scanner->block)
+      _awe_error(NULL, "Cannot allocate an input buffer for %s.", 
+                 scanner->input_name ? scanner->input_name : "input");
+  }
+  /* ('readv' because <unistd.h>'s 'truncate' clashes with the Algol W one in awe.h.) */
+  Printer_flush_all();   /* so that prompts appear before waiting for input */
+  iov.iov_base = scanner->block;
+  iov.iov_len = Scanner_BLOCKSIZE;
+  do
+    n = readv(fileno(scanner->input), &iov, 1);
+  while (n < 0 && errno == EINTR);
+  if (n < 0)
+    _awe_error(NULL, "Cannot read %s: %s.", 
+               scanner->input_name ? scanner->input_name : "input", strerror(errno));
+  scanner->base = scanner->next = scanner->counted = scanner->block;
+  scanner->end = scanner->block + n;
+  return n > 0;
+}
+
+
+/* True if the scanner is part of the way through a line. */
+
+static
+bool
+Scanner_mid_card (_awe_Scanner *scanner)
+{
+  const unsigned char *p;
+
+  for (p = scanner->next; p > scanner->base && p[-1] == '\r'; --p)
+    ;
+  return (p > scanner->base ? p[-1] : scanner->carry) != '\n';
 }
 
 
@@ -63,7 +165,7 @@ static
 void 
 Scanner_start (_awe_Scanner *scanner)
 {
-  scanner->start_line = scanner->line;
+  scanner->start_line = Scanner_line(scanner);
   scanner->buflen = 0;
 }
 
@@ -95,32 +197,45 @@ Scanner_result_string (Scanner_result result)
 }
 
 
-/* This is the only function that reads characters for a scanner. 
+/* This reads one character for a scanner. 
    '\r' characters are silently ignored to handle handle Windows '\r\n' linebreaks. */
 
-static
+static inline
 int
 Scanner_fgetc (_awe_Scanner *scanner)
 {
   int c;
-  do { c = fgetc(scanner->input); } while (c == '\r');
-  switch (c) {
-  case EOF:  ++scanner->line; scanner->column = 0; scanner->eof = true; break;
-  case '\n': ++scanner->line; scanner->column = 0; break;
-  default:   ++scanner->column; break;
-  }
+  do {
+    if (scanner->next == scanner->end && !Scanner_fill(scanner)) {
+      scanner->eof = true;
+      return EOF;
+    }
+    c = *scanner->next++;
+  } while (c == '\r');
   return c;
 }
 
 
+/* Skip the rest of the current line, if the scanner is part of the way through one. */
+
 static
 void 
 Scanner_new_card (_awe_Scanner *scanner, _awe_loc loc)
 {
-  if (scanner->eof) return;
-  while (scanner->column >= 1) {
-    (void)Scanner_fgetc(scanner);
-    if (scanner->eof) return;
+  const unsigned char *p;
+
+  if (scanner->eof || !Scanner_mid_card(scanner)) return;
+  while (true) {
+    p = memchr(scanner->next, '\n', scanner->end - scanner->next);
+    if (p) {
+      scanner->next = p + 1;
+      return;
+    }
+    scanner->next = scanner->end;
+    if (!Scanner_fill(scanner)) {
+      scanner->eof = true;
+      return;
+    }
   }
 }
 
@@ -153,6 +268,40 @@ Scanner_addstring (_awe_Scanner *scanner, char *s)
 }
 
 
+#include "scanner-loops.inc"
+
+
+/* Skip or copy the run of characters that the scanner's state loops on, so that 
+   they need not go through the state machine one at a time. Runs stop at '\r' 
+   characters, which 'Scanner_fgetc' deals with. */
+
+static
+void
+Scanner_run (_awe_Scanner *scanner)
+{
+  bool keep;
+  const int classes = Scanner_loop(scanner->state, &keep);
+  const unsigned char *p = scanner->next;
+  const unsigned char *end = scanner->end;
+  int room;
+
+  if (!classes) return;
+  if (keep) {
+    /* Leave overlong tokens to 'Scanner_addchar'. */
+    room = Scanner_BUFSIZE - 2 - scanner->buflen;
+    if (room < 0) room = 0;
+    if (end - p > room) end = p + room;
+  }
+  while (p < end && (Scanner_class[*p] & classes))
+    ++p;
+  if (keep) {
+    memcpy(scanner->buffer + scanner->buflen, scanner->next, p - scanner->next);
+    scanner->buflen += p - scanner->next;
+  }
+  scanner->next = p;
+}
+
+
 static
 Scanner_result
 Scanner_scan (_awe_Scanner *scanner)
@@ -160,6 +309,7 @@ Scanner_scan (_awe_Scanner *scanner)
   char c;
 
   while (true) {
+    Scanner_run(scanner);
     c = Scanner_fgetc(scanner);
     switch (scanner->state) {
 #include "scanner.inc"
@@ -175,7 +325,7 @@ Scanner_type_error (_awe_Scanner *scanner, _awe_loc loc, Scanner_result expected
 {
     _awe_error( loc, "Expected to read %s on line %d of %s; found %s.",
                Scanner_result_string(expected), 
-               scanner->line, 
+               Scanner_line(scanner), 
                scanner->input_name ? scanner->input_name : "input",
                Scanner_result_string(found) );
 }
@@ -208,26 +358,49 @@ Scanner_scan_for (_awe_Scanner *scanner, _awe_loc loc, Scanner_result expected)
 }
 
 
+/* Cards are copied a block at a time, with the '\r' characters taken out afterwards. */
+
 void
 _awe_readcard (_awe_loc loc, _awe_str recipient, int length)
 {
-    int c;
-    int i;
+    _awe_Scanner *scanner = _awe_active_scanner;
+    const unsigned char *newline;
+    unsigned char *from, *to;
+    size_t n;
+    int i = 0;
     
     _awe_str_cpy(recipient, length, " ", 1); /* empty string */
-    Scanner_new_card(_awe_active_scanner, loc);
-    for (i = 0; i < length; ++i) {
-        c = Scanner_fgetc(_awe_active_scanner);
-        if (c == '\n') 
-            break;
-        else if (c == EOF) {
+    Scanner_new_card(scanner, loc);
+    while (i < length) {
+        if (scanner->next == scanner->end && !Scanner_fill(scanner)) {
+            scanner->eof = true;
             _awe_process_exception(loc, endfile);
             break;
         }
+        n = scanner->end - scanner->next;
+        if (n > (size_t)(length - i))
+            n = length - i;
+        newline = memchr(scanner->next, '\n', n);
+        if (newline)
+            n = newline - scanner->next;
+        memcpy(recipient + i, scanner->next, n);
+        scanner->next += n;
+        to = recipient + i;
+        if (memchr(to, '\r', n)) {
+            for (from = to; from < recipient + i + n; ++from)
+                if (*from != '\r')
+                    *to++ = *from;
+            memset(to, ' ', recipient + i + n - to);
+        }
         else
-            recipient[i] = c;
+            to += n;
+        i = to - recipient;
+        if (newline) {
+            ++scanner->next;
+            break;
+        }
     }
-    Scanner_new_card(_awe_active_scanner, loc);
+    Scanner_new_card(scanner, loc);
 }
 
 
@@ -250,41 +423,145 @@ _awe_readcard_char (_awe_loc loc, unsigned char *recipient)
 }
 
 
+/* These parse the constants that the scanner leaves in its buffer. They only
+   need to deal with the scanner's own output, so they are simpler and faster
+   than 'strtol' and 'strtod', and they report out-of-range constants by
+   returning false. */
+
+static
+bool
+parse_integer (const unsigned char *s, int *recipient)
+{
+  const bool negative = (*s == '-');
+  const unsigned int limit = negative ? -(unsigned int)INT_MIN : INT_MAX;
+  unsigned int i = 0;
+
+  if (*s == '-' || *s == '+') ++s;
+  for (; *s >= '0' && *s <= '9'; ++s) {
+    if (i > (limit - (*s - '0')) / 10) return false;
+    i = i * 10 + (*s - '0');
+  }
+  *recipient = negative ? (int)-i : (int)i;
+  return true;
+}
+
+
+static
+bool
+parse_bits (const unsigned char *s, unsigned int *recipient)
+{
+  unsigned int b = 0;
+  int digit;
+
+  if (!*s) return false;        /* '#' on its own */
+  for (; *s; ++s) {
+    if (*s >= '0' && *s <= '9')
+      digit = *s - '0';
+    else if (*s >= 'a' && *s <= 'f')
+      digit = *s - 'a' + 10;
+    else
+      digit = *s - 'A' + 10;
+    if (b >> (sizeof b * CHAR_BIT - 4)) return false;
+    b = b << 4 | digit;
+  }
+  *recipient = b;
+  return true;
+}
+
+
+/* Powers of ten that doubles represent exactly. */
+
+static const double exact_powers_of_ten[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+/* Reals with at most 15 significant digits and small exponents are one correctly
+   rounded multiplication or division of two exact doubles (Clinger's fast path),
+   which covers almost every number people write. Anything else goes to 'strtod'.
+   'tailptr' is set to the end of the real, which is where the imaginary part of
+   a complex number starts. */
+
+static
+bool
+parse_real (const unsigned char *s, const unsigned char **tailptr, double *recipient)
+{
+  const unsigned char *p = s;
+  bool negative = false;
+  uint64_t w = 0;
+  int digits = 0;
+  int exponent = 0;
+  int e = 0;
+  bool e_negative = false;
+  double r;
+  char *end;
+
+  if (*p == '-' || *p == '+') negative = (*p++ == '-');
+  for (; *p >= '0' && *p <= '9'; ++p) {
+    if (w || *p != '0') ++digits;
+    if (digits <= 19) w = w * 10 + (*p - '0'); else ++exponent;
+  }
+  if (*p == '.')
+    for (++p; *p >= '0' && *p <= '9'; ++p) {
+      if (w || *p != '0') ++digits;
+      if (digits <= 19) {
+        w = w * 10 + (*p - '0');
+        --exponent;
+      }
+    }
+  if (*p == 'e') {
+    ++p;
+    if (*p == '-' || *p == '+') e_negative = (*p++ == '-');
+    for (; *p >= '0' && *p <= '9'; ++p)
+      if (e < 100000) e = e * 10 + (*p - '0');
+  }
+  *tailptr = p;
+  exponent += e_negative ? -e : e;
+
+  if (w == 0) {
+    *recipient = negative ? -0.0 : 0.0;
+    return true;
+  }
+  if (digits <= 15 && exponent >= -22 && exponent <= 22) {
+    r = (double)w;
+    r = exponent < 0 ? r / exact_powers_of_ten[-exponent] : r * exact_powers_of_ten[exponent];
+    *recipient = negative ? -r : r;
+    return true;
+  }
+  errno = 0;
+  r = strtod((const char *)s, &end);
+  *tailptr = (const unsigned char *)end;
+  *recipient = r;
+  return errno != ERANGE;
+}
+
+
 void
 _awe_read_integer (_awe_loc loc, int *recipient)
 {
-  int i;
-  char *tailptr;
-
   if (!Scanner_scan_for(_awe_active_scanner, loc, Integer)) {
     *recipient = 0;
     return;
   };
-  i = strtol((char *)_awe_active_scanner->buffer, &tailptr, 10);
-  if (tailptr == (char *)_awe_active_scanner->buffer && _awe_active_scanner->buffer[0] == '-')
-    Scanner_error(_awe_active_scanner, loc, "Integer too low");
-  else if (tailptr == (char *)_awe_active_scanner->buffer)
-    Scanner_error(_awe_active_scanner, loc, "Integer too high");
-  else
-    *recipient = i;
+  if (!parse_integer(_awe_active_scanner->buffer, recipient)) {
+    if (_awe_active_scanner->buffer[0] == '-')
+      Scanner_error(_awe_active_scanner, loc, "Integer too low");
+    else
+      Scanner_error(_awe_active_scanner, loc, "Integer too high");
+  }
 }
 
 
 void
 _awe_read_bits (_awe_loc loc, unsigned int *recipient)
 {
-  unsigned int i;
-  char *tailptr;
-
   if (!Scanner_scan_for(_awe_active_scanner, loc, Bits)) {
     *recipient = 0;
     return;
   };
-  i = strtoul((char *)_awe_active_scanner->buffer, &tailptr, 16);
-  if (tailptr == (char *)_awe_active_scanner->buffer)
+  if (!parse_bits(_awe_active_scanner->buffer, recipient))
     Scanner_error(_awe_active_scanner, loc, "Bits constant too high");
-  else
-    *recipient = i;
 }
 
 
@@ -330,32 +607,27 @@ _awe_read_logical (_awe_loc loc, int *recipient)
 
 
 static
-void
-test_real (_awe_loc loc)
+double
+read_real (_awe_loc loc, const unsigned char *s, const unsigned char **tailptr)
 {
-  if (fetestexcept(FE_UNDERFLOW)) {
-    feclearexcept(FE_UNDERFLOW);
-    Scanner_error(_awe_active_scanner, loc, "Real number out of range");
-  }
-  else if (fetestexcept(FE_OVERFLOW)) {
-    feclearexcept(FE_OVERFLOW);
+  double r;
+
+  if (!parse_real(s, tailptr, &r))
     Scanner_error(_awe_active_scanner, loc, "Real number out of range");
-  }
+  return r;
 }
 
 
 void _awe_read_real (_awe_loc loc, double *recipient) 
 {
-  double r;
+  const unsigned char *tailptr;
   Scanner_result result;
 
   result = Scanner_scan(_awe_active_scanner);
   switch (result) {
   case Real:
   case Integer:
-    r = strtod (_awe_active_scanner->buffer, NULL);
-    test_real(loc);
-    *recipient = r;
+    *recipient = read_real(loc, _awe_active_scanner->buffer, &tailptr);
     break;
   default:
     Scanner_exception(_awe_active_scanner, loc, Real, result);
@@ -367,7 +639,7 @@ void _awe_read_real (_awe_loc loc, double *recipient)
 void _awe_read_complex (_awe_loc loc, _Complex double *recipient) 
 {
   Scanner_result result;
-  char *tailptr;
+  const unsigned char *tailptr;
   double r, i;
 
   result = Scanner_scan(_awe_active_scanner);
@@ -375,20 +647,15 @@ void _awe_read_complex (_awe_loc loc, _Complex double *recipient)
   switch (result) {
   case Real:
   case Integer:
-    r = strtod (_awe_active_scanner->buffer, NULL);
-    test_real(loc);
-    *recipient = r;
+    *recipient = read_real(loc, _awe_active_scanner->buffer, &tailptr);
     break;
   case Imaginary:
-    r = strtod (_awe_active_scanner->buffer, NULL);
-    test_real(loc);
+    r = read_real(loc, _awe_active_scanner->buffer, &tailptr);
     *recipient = r * I;
     break;
   case Complex:
-    r = strtod (_awe_active_scanner->buffer, &tailptr);
-    test_real(loc);
-    i = strtod (tailptr, NULL);
-    test_real(loc);
+    r = read_real(loc, _awe_active_scanner->buffer, &tailptr);
+    i = read_real(loc, tailptr, &tailptr);
     *recipient = r + i * I;
     break;
   default:
@@ -457,6 +724,136 @@ _awe_Printer_initialize (_awe_Printer *printer, FILE *file)
   printer->strict_line_breaks = _awe_env_bool(NULL, "AWE_STRICT_LINE_BREAKS", false);
   printer->trim_lines         = _awe_env_bool(NULL, "AWE_TRIM_LINES",         true);
   printer->eject_last_page    = _awe_env_bool(NULL, "AWE_EJECT_LAST_PAGE",    false);
+  printer->buflen = 0;
+}
+
+
+/* Printers assemble each line in their buffers, and write it to their output 
+   at the line break. (Only overlong lines are written in more than one piece.) */
+
+static
+void
+Printer_flush (_awe_Printer *printer)
+{
+  if (printer->buflen > 0) {
+    fwrite(printer->buffer, 1, printer->buflen, printer->output);
+    printer->buflen = 0;
+  }
+}
+
+
+static
+void
+Printer_flush_all (void)
+{
+  Printer_flush(&_awe_stdout_printer);
+  Printer_flush(&_awe_stderr_printer);
+  fflush(stdout);
+}
+
+
+void
+_awe_flush_printers (void)
+{
+  Printer_flush(&_awe_stdout_printer);
+  Printer_flush(&_awe_stderr_printer);
+}
+
+
+/* Returns a place in the buffer for 'n' more characters. */
+
+static inline
+unsigned char *
+Printer_reserve (_awe_Printer *printer, int n)
+{
+  assert(n <= Printer_BUFSIZE);
+  if (printer->buflen + n > Printer_BUFSIZE)
+    Printer_flush(printer);
+  return printer->buffer + printer->buflen;
+}
+
+
+static
+void
+Printer_put (_awe_Printer *printer, const unsigned char *s, int n)
+{
+  if (n > Printer_BUFSIZE) {
+    Printer_flush(printer);
+    fwrite(s, 1, n, printer->output);
+  }
+  else {
+    memcpy(Printer_reserve(printer, n), s, n);
+    printer->buflen += n;
+  }
+}
+
+
+static inline
+void
+Printer_putc (_awe_Printer *printer, unsigned char c)
+{
+  *Printer_reserve(printer, 1) = c;
+  printer->buflen++;
+}
+
+
+static
+void
+Printer_repeat (_awe_Printer *printer, unsigned char c, int n)
+{
+  int chunk;
+
+  while (n > 0) {
+    chunk = n < Printer_BUFSIZE ? n : Printer_BUFSIZE;
+    memset(Printer_reserve(printer, chunk), c, chunk);
+    printer->buflen += chunk;
+    n -= chunk;
+  }
+}
+
+
+/* Prints 'n' characters right justified in a field of width 'w', or left justified
+   if 'w' is negative, like printf's "%*s". */
+
+static
+void
+Printer_justify (_awe_Printer *printer, const char *s, int n, int w)
+{
+  if (w > n)
+    Printer_repeat(printer, ' ', w - n);
+  Printer_put(printer, (const unsigned char *)s, n);
+  if (-w > n)
+    Printer_repeat(printer, ' ', -w - n);
+}
+
+
+/* These write numbers backwards from 'end', returning the start of the number. */
+
+static
+char *
+format_integer (char *end, int i)
+{
+  unsigned int u = i < 0 ? -(unsigned int)i : (unsigned int)i;
+
+  do {
+    *--end = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (i < 0)
+    *--end = '-';
+  return end;
+}
+
+
+static
+char *
+format_bits (char *end, unsigned int x)
+{
+  do {
+    *--end = "0123456789ABCDEF"[x & 0xF];
+    x >>= 4;
+  } while (x);
+  return end;
 }
 
 
@@ -492,10 +889,7 @@ static
 void
 Printer_tab_field (_awe_Printer *printer, _awe_loc loc)
 {
-  int i;
-
-  for (i = printer->true_column; i < printer->column; ++i)
-    fputc(' ', printer->output);
+  Printer_repeat(printer, ' ', printer->column - printer->true_column);
   printer->true_column = printer->column;
 }
 
@@ -536,7 +930,8 @@ Printer_really_line_break (_awe_Printer *printer, _awe_loc loc)
     Printer_page_break(printer, loc);
   else {
     /* start a new line */
-    fputc('\n', printer->output);
+    Printer_putc(printer, '\n');
+    Printer_flush(printer);
     printer->column = 1;
     printer->true_column = 1;
     printer->line++;
@@ -569,22 +964,21 @@ Printer_page_break (_awe_Printer *printer, _awe_loc loc)
      replace the last line feed of the page with a form feed. */
   assert(printer->line >= 1 && printer->line <= printer->page_height);
   while (printer->line < printer->page_height) {
-        fputc('\n', printer->output);
+        Printer_putc(printer, '\n');
       ++printer->line;
    }
     if (printer->hard_page_breaks || printer->pretty_page_breaks)
         if (printer->pretty_page_breaks)
             { 
-                int i;
-                fputc('\n', printer->output);
-                for (i = 0; i < printer->page_width; ++i)
-                    fputc('~', printer->output);
-                fputc('\n', printer->output);
+                Printer_putc(printer, '\n');
+                Printer_repeat(printer, '~', printer->page_width);
+                Printer_putc(printer, '\n');
             }
         else
-            fputc('\f', printer->output);
+            Printer_putc(printer, '\f');
     else 
-        fputc('\n', printer->output);
+        Printer_putc(printer, '\n');
+    Printer_flush(printer);
     printer->line = 1;
     printer->column = 1;
     printer->true_column = 1;
@@ -595,122 +989,253 @@ Printer_page_break (_awe_Printer *printer, _awe_loc loc)
 }
 
 
+/* The fields of a WRITE are written by these functions, which are given the active printer
+   and the editing variables (limited to 132) rather than looking them up for each field. */
+
+static
+void
+Editing_get (_awe_Editing_t *e)
+{
+  e->i_w = LIMIT_WIDTH(i_w);
+  e->s_w = LIMIT_WIDTH(s_w);
+  e->r_w = LIMIT_WIDTH(r_w);
+  e->r_d = LIMIT_WIDTH(r_d);
+  e->r_format = r_format;
+}
+
+
+static
 void 
-_awe_write_integer(_awe_loc loc, int i)
+write_integer (_awe_Printer *printer, _awe_loc loc, const _awe_Editing_t *e, int i)
 {
-  int w = LIMIT_WIDTH(i_w);
+  int w = e->i_w;
+  char digits[16];
+  char *start;
 
-  Printer_start_field(_awe_active_printer, loc, abs(w));
-  fprintf(_awe_active_printer->output, "%*d", w, i);
-  Printer_end_field(_awe_active_printer, loc, abs(w), abs(w) + LIMIT_WIDTH(s_w));
+  Printer_start_field(printer, loc, abs(w));
+  start = format_integer(digits + sizeof digits, i);
+  Printer_justify(printer, start, digits + sizeof digits - start, w);
+  Printer_end_field(printer, loc, abs(w), abs(w) + e->s_w);
 
 }
 
 
+static
 void 
-_awe_write_logical(_awe_loc loc, int b)
+write_logical (_awe_Printer *printer, _awe_loc loc, const _awe_Editing_t *e, int b)
 {
-  Printer_start_field(_awe_active_printer, loc, 6);
-  fprintf(_awe_active_printer->output, "%6s", (b ? "TRUE" : "FALSE"));
-  Printer_end_field(_awe_active_printer, loc, 6, 6 + LIMIT_WIDTH(s_w));
+  Printer_start_field(printer, loc, 6);
+  Printer_justify(printer, (b ? "TRUE" : "FALSE"), (b ? 4 : 5), 6);
+  Printer_end_field(printer, loc, 6, 6 + e->s_w);
 }
 
 
+static
 void 
-_awe_write_bits(_awe_loc loc, unsigned int x)
+write_bits (_awe_Printer *printer, _awe_loc loc, const _awe_Editing_t *e, unsigned int x)
 {
-  Printer_start_field(_awe_active_printer, loc, 14);
-  fprintf(_awe_active_printer->output, "%14X", x);
-  Printer_end_field(_awe_active_printer, loc, 14, 14 + LIMIT_WIDTH(s_w));
+  char digits[8];
+  char *start;
+
+  Printer_start_field(printer, loc, 14);
+  start = format_bits(digits + sizeof digits, x);
+  Printer_justify(printer, start, digits + sizeof digits - start, 14);
+  Printer_end_field(printer, loc, 14, 14 + e->s_w);
 }
 
 
+static
 void 
-_awe_write_string (_awe_loc loc, _awe_str s, int length)
+write_string (_awe_Printer *printer, _awe_loc loc, _awe_str s, int length)
 {
-  int i, n;
+  int n;
 
-  Printer_break_field(_awe_active_printer, loc, length);
-  n = _awe_active_printer->trim_lines ? _awe_str_unpadded_length(s, length) : length;
+  Printer_break_field(printer, loc, length);
+  n = printer->trim_lines ? _awe_str_unpadded_length(s, length) : length;
   if (n > 0) {
-    Printer_tab_field(_awe_active_printer, loc);
-    for (i = 0; i < n; ++i)
-      fputc(s[i], _awe_active_printer->output);
+    Printer_tab_field(printer, loc);
+    Printer_put(printer, s, n);
   }
-  Printer_end_field(_awe_active_printer, loc, n, length);
+  Printer_end_field(printer, loc, n, length);
 }
 
 
+static
 void 
-_awe_write_char (_awe_loc loc, unsigned char c)
+write_char (_awe_Printer *printer, _awe_loc loc, unsigned char c)
 {
-  Printer_break_field(_awe_active_printer, loc, 1);
-  if (c == ' ' && _awe_active_printer->trim_lines)
-    Printer_end_field(_awe_active_printer, loc, 0, 1);
+  Printer_break_field(printer, loc, 1);
+  if (c == ' ' && printer->trim_lines)
+    Printer_end_field(printer, loc, 0, 1);
   else {
-    Printer_tab_field(_awe_active_printer, loc);
-    fputc(c, _awe_active_printer->output);
-    Printer_end_field(_awe_active_printer, loc, 1, 1);
+    Printer_tab_field(printer, loc);
+    Printer_putc(printer, c);
+    Printer_end_field(printer, loc, 1, 1);
   }
 }
 
 
+/* Formats a REAL number with 'format', replacing the "e" in C exponent notation 
+   with Algol W's "'". Returns the length of the formatted number. */
 
-static char real_buffer[256];
-
-/* Replace the "e" in C exponent notation with Algol W's "'" */
 static
-void 
-replace_e (void) {
-    int i;
-    for (i = 0; i < 256 && real_buffer[i] != '\0'; ++i)
-        if (real_buffer[i] == 'e') {
-            real_buffer[i] = '\'';
-            break;
-        }
+int
+format_real (char *buffer, size_t size, const char *format, int w, int d, double r)
+{
+  char *e;
+  int n;
+
+  n = snprintf(buffer, size, format, w, d, r);
+  if ((size_t)n < size && (e = memchr(buffer, 'e', n)))
+    *e = '\'';
+  return n;
 }
 
-/* Writes a REAL number using the format specified in 'r_format'.
-   Note that this prints "e" signs instead of "'" signs.
+
+/* Writes a REAL number using the format specified in 'r_format'. Real numbers are
+   still converted by 'snprintf', which rounds exactly, but straight into the line.
    Returns the length of the string actually printed. It will be longer than specified when necessary. */
 static
 int 
-_awe_write_real_any(_awe_loc loc, double r)
+write_real_any (_awe_Printer *printer, _awe_loc loc, const _awe_Editing_t *e, double r)
 {
-  int w = LIMIT_WIDTH(r_w);
-  int d = LIMIT_WIDTH(r_d);
+  int w = e->r_w;
+  int d = e->r_d;
+  const char *format;
+  int n;
 
-  switch (r_format) {
+  switch (e->r_format) {
   case 'A': case 'a':
-    sprintf(real_buffer, "%*.*f", w, d, r);
+    format = "%*.*f";
     break;
   case 'S': case 's':
-    if (r == 0.0) 
+    if (r == 0.0) {
       /* Is is done to be consistent with page 42 of the June 1972 Reference Manual */
-      sprintf(real_buffer, "%*s", w, "0    ");
-    else
-      sprintf(real_buffer, "%*.*e", w, (w - 8), r); 
+      Printer_justify(printer, "0    ", 5, w);
+      return abs(w) > 5 ? abs(w) : 5;
+    }
+    format = "%*.*e";
+    d = w - 8;
     break;
   case 'F': case 'f':
-    sprintf(real_buffer, "%*.*g", w, (w - 7), r);
+    format = "%*.*g";
+    d = w - 7;
     break;
   default:
-    _awe_error(loc, "R_FORMAT = \"%c\", this is not a valid format code.", r_format);
+    _awe_error(loc, "R_FORMAT = \"%c\", this is not a valid format code.", e->r_format);
+    return 0;
+  }
+  n = format_real((char *)printer->buffer + printer->buflen, Printer_BUFSIZE - printer->buflen, format, w, d, r);
+  if (n >= Printer_BUFSIZE - printer->buflen) {
+    Printer_flush(printer);
+    n = format_real((char *)printer->buffer, Printer_BUFSIZE, format, w, d, r);
+    assert(n < Printer_BUFSIZE);
   }
-  replace_e();
-  fprintf(_awe_active_printer->output, "%*s", w, real_buffer);
-  return strlen(real_buffer);
+  printer->buflen += n;
+  return n;
+}
+
+
+static
+void 
+write_real (_awe_Printer *printer, _awe_loc loc, const _awe_Editing_t *e, double r)
+{
+  int w = e->r_w;
+
+  Printer_start_field(printer, loc, abs(w));
+  w = write_real_any(printer, loc, e, r);
+  Printer_end_field(printer, loc, abs(w), abs(w) + e->s_w);
+}
+
+
+static
+void 
+write_complex (_awe_Printer *printer, _awe_loc loc, const _awe_Editing_t *e, _Complex double x)
+{
+  int w = e->r_w;
+  int w2;
+
+  Printer_start_field(printer, loc, w * 2);
+  w2 = write_real_any(printer, loc, e, creal(x));
+  Printer_putc(printer, ' ');
+  w2 += write_real_any(printer, loc, e, cimag(x));
+  Printer_putc(printer, 'I');
+  Printer_end_field(printer, loc, abs(w2), abs(w2) + e->s_w);
+}
+
+
+static
+void
+write_reference (_awe_Printer *printer, _awe_loc loc, const _awe_Editing_t *e, void *ref)
+{
+    static char buffer [128];
+    int w = e->i_w;
+    
+    Printer_start_field(printer, loc, w);
+    if (ref == NULL)
+        Printer_justify(printer, "null", 4, w);
+    else if (ref == _awe_uninitialized_reference)
+        Printer_justify(printer, "UNINITIALIZED", 13, w);
+    else {
+        sprintf(buffer, "%s.%i", _awe_class(ref), _awe_record_number(ref));
+        assert(strlen(buffer) < 127);
+        Printer_justify(printer, buffer, strlen(buffer), w);
+    }
+    Printer_end_field(printer, loc, w, w + e->s_w);
+}
+
+
+void 
+_awe_write_integer(_awe_loc loc, int i)
+{
+  _awe_Editing_t e;
+
+  Editing_get(&e);
+  write_integer(_awe_active_printer, loc, &e, i);
+}
+
+
+void 
+_awe_write_logical(_awe_loc loc, int b)
+{
+  _awe_Editing_t e;
+
+  Editing_get(&e);
+  write_logical(_awe_active_printer, loc, &e, b);
+}
+
+
+void 
+_awe_write_bits(_awe_loc loc, unsigned int x)
+{
+  _awe_Editing_t e;
+
+  Editing_get(&e);
+  write_bits(_awe_active_printer, loc, &e, x);
+}
+
+
+void 
+_awe_write_string (_awe_loc loc, _awe_str s, int length)
+{
+  write_string(_awe_active_printer, loc, s, length);
+}
+
+
+void 
+_awe_write_char (_awe_loc loc, unsigned char c)
+{
+  write_char(_awe_active_printer, loc, c);
 }
 
 
 void 
 _awe_write_real(_awe_loc loc, double r)
 {
-  int w = LIMIT_WIDTH(r_w);
+  _awe_Editing_t e;
 
-  Printer_start_field(_awe_active_printer, loc, abs(w));
-  w = _awe_write_real_any(loc,r);
-  Printer_end_field(_awe_active_printer, loc, abs(w), abs(w) + LIMIT_WIDTH(s_w));
+  Editing_get(&e);
+  write_real(_awe_active_printer, loc, &e, r);
 }
 
 
@@ -724,15 +1249,10 @@ _awe_write_long_real(_awe_loc loc, double r)
 void 
 _awe_write_complex(_awe_loc loc, _Complex double x)
 {
-  int w = LIMIT_WIDTH(r_w);
-  int w2;
+  _awe_Editing_t e;
 
-  Printer_start_field(_awe_active_printer, loc, w * 2);
-  w2 = _awe_write_real_any(loc, creal(x));
-  fputc(' ', _awe_active_printer->output);
-  w2 += _awe_write_real_any(loc, cimag(x));
-  fputc('I', _awe_active_printer->output);
-  Printer_end_field(_awe_active_printer, loc, abs(w2), abs(w2) + LIMIT_WIDTH(s_w));
+  Editing_get(&e);
+  write_complex(_awe_active_printer, loc, &e, x);
 }
 
 
@@ -746,20 +1266,39 @@ _awe_write_long_complex(_awe_loc loc, _Complex double x)
 void
 _awe_write_reference(_awe_loc loc, void *ref)
 {
-    static char buffer [128];
-    int w = LIMIT_WIDTH(i_w);
-    
-    Printer_start_field(_awe_active_printer, loc, w);
-    if (ref == NULL)
-        fprintf(_awe_active_printer->output, "%*s", w, "null");
-    else if (ref == _awe_uninitialized_reference)
-        fprintf(_awe_active_printer->output, "%*s", w, "UNINITIALIZED");
-    else {
-        sprintf(buffer, "%s.%i", _awe_class(ref), _awe_record_number(ref));
-        assert(strlen(buffer) < 127);
-        fprintf(_awe_active_printer->output, "%*s", w, buffer);
+  _awe_Editing_t e;
+
+  Editing_get(&e);
+  write_reference(_awe_active_printer, loc, &e, ref);
+}
+
+
+/* A whole WRITE or WRITEON statement whose parameters cannot change the editing variables
+   or the active printer. The compiler describes the fields with a static array, and packs
+   their values into another. */
+
+void
+_awe_write_fields (_awe_loc loc, int new_line, int count, const _awe_Write_field_t *fields, const _awe_Write_value_t *values)
+{
+  _awe_Printer *printer = _awe_active_printer;
+  _awe_Editing_t e;
+  int k;
+
+  Editing_get(&e);
+  if (new_line)
+    Printer_line_break(printer, loc);
+  for (k = 0; k < count; ++k)
+    switch (fields[k].kind) {
+    case 'i': write_integer(printer, loc, &e, values[k].i); break;
+    case 'r': write_real(printer, loc, &e, values[k].r); break;
+    case 'z': write_complex(printer, loc, &e, values[k].z); break;
+    case 'l': write_logical(printer, loc, &e, values[k].i); break;
+    case 'b': write_bits(printer, loc, &e, values[k].b); break;
+    case 'c': write_char(printer, loc, values[k].c); break;
+    case 's': write_string(printer, loc, values[k].s, fields[k].length); break;
+    case 'p': write_reference(printer, loc, &e, values[k].ref); break;
+    default: assert(0);
     }
-    Printer_end_field(_awe_active_printer, loc, w, w + LIMIT_WIDTH(s_w));
 }
 
 
@@ -856,6 +1395,7 @@ _awe_Printer_finalize (_awe_loc loc, _awe_Printer *printer)
         Printer_page_break(printer, loc);  
     else
         Printer_line_break(printer, loc);  
+    Printer_flush(printer);
 }
 
 
@@ -26,18 +26,31 @@ License along with Awe.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #define Scanner_BUFSIZE 512
+#define Scanner_BLOCKSIZE (256 * 1024)
+#define Printer_BUFSIZE 1024
 
 
+/* Scanners read the characters between 'next' and 'end', which are in a memory-mapped 
+   input file or a block read from the input. Line numbers are counted only when they 
+   are needed, up to 'counted'. */
+
 typedef struct {
     FILE *input;
     char *input_name;
     bool eof;
     int state;
-    int line;
-    int column;
+    int line;                   /* The line number at 'counted' */
     int start_line;
     unsigned char buffer[Scanner_BUFSIZE];
     int buflen;
+    const unsigned char *base;  /* The start of the mapped file or the current block */
+    const unsigned char *next;
+    const unsigned char *end;
+    const unsigned char *counted;
+    int carry;                  /* The last character before 'base', other than '\r' */
+    unsigned char *block;       /* A buffer for reading blocks, if the input is not mapped */
+    void *mapping;
+    size_t mapping_size;
 } _awe_Scanner;
 
 
@@ -60,6 +73,8 @@ typedef struct {
     bool strict_line_breaks; /* Do not allow over-long WRITE fields to overflow the line. */
     bool trim_lines;         /* Do not print spaces at the ends of lines. */
     bool eject_last_page;    /* Perform a page break at the end of the program. */
+    unsigned char buffer[Printer_BUFSIZE];  /* The line being printed, not yet written to 'output' */
+    int buflen;
 
 } _awe_Printer;
 
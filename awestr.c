@@ -28,9 +28,18 @@ License along with Awe.  If not, see <http://www.gnu.org/licenses/>.
    nnn: Tried to copy invalid substring (-3|3).
 */
 
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #ifndef AWESTRING_TEST
 #include "awe.h"
 #endif
@@ -92,17 +101,100 @@ _awe_str_cast_c (unsigned char c, int length)
 }
 
 
-int 
-_awe_str_unpadded_length (const _awe_str src, int srclen)
+/* Spaces ------------------------------------------------------------------------------------- */
+
+/* Strings are padded with spaces, which these look for 32 or 16 bytes at a time where 
+   AVX2 or SSE2 are available, otherwise 8 bytes at a time. */
+
+#define SPACES8 0x2020202020202020ull
+
+
+/* True if the 'n' bytes at 's' are all spaces. */
+
+static
+int
+all_spaces (const unsigned char *s, int n)
 {
-    int i;
-    for (i = srclen; i > 0; --i)
-        if (src[i - 1] != ' ')
+    int i = 0;
+#ifdef __AVX2__
+    const __m256i spaces32 = _mm256_set1_epi8(' ');
+    for (; i + 32 <= n; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, spaces32)) != -1)
+            return 0;
+    }
+#endif
+#ifdef __SSE2__
+    const __m128i spaces16 = _mm_set1_epi8(' ');
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, spaces16)) != 0xFFFF)
+            return 0;
+    }
+#endif
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        if (w != SPACES8)
+            return 0;
+    }
+    for (; i < n; ++i)
+        if (s[i] != ' ')
+            return 0;
+    return 1;
+}
+
+
+/* The length of the 'n' bytes at 's' without the spaces at the end. */
+
+static
+int
+last_non_space (const unsigned char *s, int n)
+{
+    int i = n;
+#ifdef __AVX2__
+    const __m256i spaces32 = _mm256_set1_epi8(' ');
+    for (; i >= 32; i -= 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(s + i - 32));
+        const unsigned other = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, spaces32));
+        if (other)
+            return i - __builtin_clz(other);
+    }
+#endif
+#ifdef __SSE2__
+    const __m128i spaces16 = _mm_set1_epi8(' ');
+    for (; i >= 16; i -= 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(s + i - 16));
+        const unsigned other = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, spaces16)) & 0xFFFF;
+        if (other)
+            return i + 16 - __builtin_clz(other);
+    }
+#endif
+    for (; i >= 8; i -= 8) {
+        uint64_t w;
+        memcpy(&w, s + i - 8, 8);
+        if (w != SPACES8) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return i - __builtin_clzll(w ^ SPACES8) / 8;
+#else
+            return i - __builtin_ctzll(w ^ SPACES8) / 8;
+#endif
+        }
+    }
+    for (; i > 0; --i)
+        if (s[i - 1] != ' ')
             break;
     return i;
 }
 
 
+int 
+_awe_str_unpadded_length (const _awe_str src, int srclen)
+{
+    return last_non_space(src, srclen);
+}
+
+
 void
 _awe_str_unpadded_copy (char *s,  const _awe_str src, int srclen)
 {
@@ -114,6 +206,19 @@ _awe_str_unpadded_copy (char *s,  const _awe_str src, int srclen)
 }
 
 
+void
+_awe_str_sub_error (_awe_loc loc, int srclen, int index, int length)
+{
+    if (index < 0 || length <= 0)
+        _awe_error( loc, "Invalid substring (%d|%d).", index, length);
+    else
+        _awe_error( loc, "Substring (%d|%d) of a string of length %d.", index, length, srclen );
+    abort();  /* not reached, '_awe_error' exits */
+}
+
+
+/* The library copies of the inline functions in "awe.h". */
+
 _awe_str 
 _awe_str_sub (_awe_loc loc, const _awe_str src, int srclen, int index, int length)
 {
@@ -121,11 +226,8 @@ _awe_str_sub (_awe_loc loc, const _awe_str src, int srclen, int index, int lengt
     assert(srclen >= 1);
     assert(length > 0);
     
-    if (index < 0 || length <= 0)
-        _awe_error( loc, "Invalid substring (%d|%d).", index, length);
-    
-    if (index + length > srclen)
-        _awe_error( loc, "Substring (%d|%d) of a string of length %d.", index, length, srclen );
+    if (index < 0 || length <= 0 || index + length > srclen)
+        _awe_str_sub_error(loc, srclen, index, length);
     
     return src + index;
 }
@@ -142,7 +244,7 @@ _awe_str_cpy (_awe_str dst, int dstlen, const _awe_str src, int srclen)
 
     memcpy(dst, src, srclen);
     if (srclen < dstlen)
-        memset(dst + srclen, ' ', dstlen - srclen);
+        _awe_fill(dst + srclen, dstlen - srclen, 1, " ");
     return src;
 }
 
@@ -235,19 +337,61 @@ _awe_str_cmp_cc (unsigned char c1, unsigned char c2)
 }
 
 
-/* Compare two equal length strings in EBCDIC order */
+/* The index of the first byte where 'a' and 'b' differ, or 'n' if they do not.
+   This compares 32 or 16 bytes at a time where AVX2 or SSE2 are available, 
+   otherwise 8 bytes at a time. */
 
 static
 int
-ebcdic_memcmp (const _awe_str a, const _awe_str b, int n)
+first_difference (const unsigned char *a, const unsigned char *b, int n)
 {
-    int i, cmp;
-    for (i = 0; i < n; ++i) {
-        cmp = _awe_str_cmp_cc(a[i], b[i]);
-        if (cmp != 0)
-            return cmp;
+    int i = 0;
+#ifdef __AVX2__
+    for (; i + 32 <= n; i += 32) {
+        const __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        const __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        const unsigned differ = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (differ)
+            return i + __builtin_ctz(differ);
     }
-    return 0;
+#endif
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        const unsigned differ = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xFFFF;
+        if (differ)
+            return i + __builtin_ctz(differ);
+    }
+#endif
+    for (; i + 8 <= n; i += 8) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        if (wa != wb) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return i + __builtin_ctzll(wa ^ wb) / 8;
+#else
+            return i + __builtin_clzll(wa ^ wb) / 8;
+#endif
+        }
+    }
+    for (; i < n; ++i)
+        if (a[i] != b[i])
+            return i;
+    return n;
+}
+
+
+/* Compare two equal length strings in EBCDIC order. Latin-1 and EBCDIC characters
+   correspond one to one, so only the first differing characters need translating. */
+
+static
+int
+ebcdic_memcmp (const _awe_str a, const _awe_str b, int n)
+{
+    const int i = first_difference(a, b, n);
+    return i == n ? 0 : _awe_str_cmp_cc(a[i], b[i]);
 }
 
 
@@ -258,22 +402,19 @@ int
 long_cmp ( const _awe_str str1, int str1len, 
            const _awe_str str2, int str2len )
 {
-    int i, n;
+    int n;
 
     assert(str1len >= str2len);
 
     n = ebcdic_memcmp(str1, str2, str2len);
     if (n != 0) return n;
-    for (i = str2len; i < str1len; ++i)
-        if (str1[i] != ' ')
-            return 1;
-    return 0;
+    return all_spaces(str1 + str2len, str1len - str2len) ? 0 : 1;
 }
 
 
 int 
-_awe_str_cmp ( const _awe_str str1, int str1len, 
-              const _awe_str str2, int str2len )
+_awe_str_collate ( const _awe_str str1, int str1len, 
+                   const _awe_str str2, int str2len )
 {
     assert(str1);
     assert(str1len > 0);
@@ -287,6 +428,16 @@ _awe_str_cmp ( const _awe_str str1, int str1len,
 }
 
 
+/* The library copy of the inline function in "awe.h". */
+
+int 
+_awe_str_cmp ( const _awe_str str1, int str1len, 
+              const _awe_str str2, int str2len )
+{
+    return _awe_str_collate(str1, str1len, str2, str2len);
+}
+
+
 int 
 _awe_str_cmp_sc ( const _awe_str str1, int str1len, unsigned char c )
 {
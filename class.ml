@@ -42,6 +42,8 @@ let to_id c     = fst (DynArray.get global_class_array c)
 
 let to_string c = snd (DynArray.get global_class_array c)
 
+let number c = c
+
 let contents () = DynArray.to_list global_class_array
 
       
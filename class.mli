@@ -32,6 +32,8 @@ val to_id : t -> Table.Id.t
 
 val to_string : t -> string  (* the C identifier for the class *)
 
+val number : t -> int  (* the class number that tags records at run time *)
+
 val contents : unit -> (Table.Id.t * string) list
 
 (* end *)
@@ -84,6 +84,7 @@ and procedure_header_t = {
   proc_id    : Id.t;
   proc_loc   : Location.t;
   parameters : formal_parameters_t;
+  formal_ids : Id.t list;            (* the formal parameters' identifiers, in order *)
   header     : Code.t;               (* C-code header for a procedure's C function and prototype *)
   body       : Tree.t                (* the parse tree of the body of a procedure, saved for later. *)
 }
@@ -154,7 +155,10 @@ exception Error of Location.t * string
 
 let error loc = Printf.ksprintf (fun message -> (raise (Error(loc, message))))
 
-let warning loc = Printf.kprintf (fun message -> prerr_endline (Location.to_string loc ^ " " ^ message))
+let quiet_warnings = ref false  (* set while compiling code a second time *)
+
+let warning loc = 
+  Printf.kprintf (fun message -> if not !quiet_warnings then prerr_endline (Location.to_string loc ^ " " ^ message))
 
 let output = Printf.printf
 
@@ -297,13 +301,35 @@ let code_of_int  (i : int) : Code.t = Code.string (string_of_int i)
 
 
 (* 'code_of_loc' returns an C code function argument denoting an Algol source location.  
-    This is used in function calls that might raise runtime errors. *)
+    This is used in function calls that might raise runtime errors. 
+
+    The locations are entries in a static table, '_awe_locs', which 'location_table' declares
+    once the program has been compiled. Each location used gets one entry. *)
+
+let locations : (int * int * int, int) Hashtbl.t = Hashtbl.create 1000
+
+let location_entries : (int * int * int) list ref = ref []  (* in reverse order *)
 
 let code_of_loc (loc : Location.t) : Code.t =
-  Code.string ( sprintf "_awe_at(%i,%i,%i)"
-                  (Location.file_number loc)
-                  (Location.line loc)
-                  (Location.column loc) )
+  let key = (Location.file_number loc, Location.line loc, Location.column loc) in
+  let index =
+    try 
+      Hashtbl.find locations key
+    with Not_found ->
+      let index = Hashtbl.length locations in
+      Hashtbl.add locations key index ;
+      location_entries := key :: !location_entries ;
+      index
+  in
+  Code.string (sprintf "_awe_at(%i)" index)
+
+let location_table () : Code.t =
+  if !location_entries = [] then
+    Code.empty
+  else
+    let entry (file, line, column) = Code.string (sprintf "{_awe_src_%i, %i, %i}" file line column) in
+    "static const struct _awe_LOC _awe_locs[] = {\n$\n};\n" $$ 
+      [Code.separate ",\n" (List.rev_map entry !location_entries)]
 
 
 let c_char_const (character : string) : Code.t = 
@@ -366,9 +392,23 @@ let cast (loc : Location.t) (t : simple_t) (e : typed_code_t) : Code.t =
     | String desired_length, String length when desired_length <> length -> 
         "_awe_str_cast($, $, $)" $$ [e.c; code_of_int length; code_of_int desired_length]
     | Reference d_set, Reference e_set when not (ClassSet.subset e_set d_set) ->
-        let append_class_id c l = (Code.id (Class.to_id c)) :: l in
-        let class_list = Code.separate ", "  (ClassSet.fold append_class_id d_set []) in
-        "_awe_ref_cast($, $, $)" $$ [code_of_loc loc; e.c; class_list]
+        (* The classes are tested with a bitmask of their class numbers. *)
+        let classes = ClassSet.elements d_set in
+        let type_name =  (* the classes are named from the last declared, as they always have been *)
+          c_str_const (sprintf "a REFERENCE(%s)" (String.concat ", " (List.map Class.to_string (List.rev classes))))
+        in
+        let nwords = 1 + List.fold_left (fun n c -> max n (Class.number c / 64)) 0 classes in
+        let word i = 
+          let bit mask c = 
+            if Class.number c / 64 = i then Int64.logor mask (Int64.shift_left 1L (Class.number c mod 64)) else mask 
+          in
+          Code.string (sprintf "0x%LxULL" (List.fold_left bit 0L classes))
+        in
+        if nwords = 1 then
+          "_awe_ref_cast($, $, $, $)" $$ [code_of_loc loc; e.c; word 0; type_name]
+        else
+          "_awe_ref_cast_set($, $, (const unsigned long long[]){$}, $, $)" $$ 
+            [code_of_loc loc; e.c; Code.separate ", " (mapn 0 (nwords - 1) word); code_of_int nwords; type_name]
     | _, _ -> 
         e.c
   else
@@ -484,7 +524,7 @@ let assignment_statement (loc : Location.t) (d : typed_code_t) (e : typed_code_t
 let optionally_initialize_simple (t : simple_t) (var : Code.t) : Code.t =
     match t with
     | String n when n > 1 && !Options.initialize_all -> 
-        "_awe_str_cpy($, $, $, $);\n" $$ [var; code_of_int n; blank_string n; code_of_int n]
+        "_awe_str_init($, $);\n" $$ [var; code_of_int n]
     | Reference _ ->
         "$ = $;\n" $$ [var; default t]
     | _ when !Options.initialize_all -> 
@@ -513,6 +553,1186 @@ let copy_if_string (expr : typed_code_t) : Code.t =
   | _ -> expr.c
 
 
+(* * Constant array bounds ----------------------------------------------------------------- *)
+
+(* Most arrays are declared with integer constants for bounds. Their strides 
+   are constants too, so instead of going through the array descriptor, their 
+   elements are indexed directly with constant multipliers and offsets, which 
+   GCC can strength-reduce and vectorize. 'add_array_declaration' records the 
+   shape of such arrays here, for 'designator_or_expression' and 
+   'hoist_array_checks', filed under their identifiers and told apart by the 
+   physical identity of their definitions. *)
+
+type fixed_array_t = {
+  fixed_bounds : (int * int) list;  (* lower and upper bound of each dimension *)
+  strides      : int list;          (* number of elements between each subscript of a dimension *)
+  fixed_offset : int;               (* total of offsets to element 0 in all dimensions, in elements *)
+  nelements    : int
+}
+
+module IdHashtbl = Hashtbl.Make (struct type t = Id.t let equal = Id.eq let hash = Id.hash end)
+
+let fixed_arrays : (Type.definition_t * fixed_array_t) list IdHashtbl.t = IdHashtbl.create 100
+
+let fixed_array (array_id : Id.t) (array_defn : Type.definition_t) : fixed_array_t option =
+  try Some (List.assq array_defn (IdHashtbl.find fixed_arrays array_id)) with Not_found -> None
+
+let add_fixed_array (array_id : Id.t) (array_defn : Type.definition_t) (fixed : fixed_array_t) : unit =
+  let others = try IdHashtbl.find fixed_arrays array_id with Not_found -> [] in
+  IdHashtbl.replace fixed_arrays array_id ((array_defn, fixed) :: others)
+
+
+(* The value of an integer expression made only of literals, if it fits in 32 bits. *)
+
+let rec constant_integer (tree : Tree.t) : int option =
+  let within i = if i >= -2147483648 && i <= 2147483647 then Some i else None in
+  match tree with
+  | Tree.Integer (_, s) -> 
+      ( try within (int_of_string s) with Failure _ -> None )
+  | Tree.Unary (_, Tree.NEG, e) -> 
+      ( match constant_integer e with Some i -> within (- i) | None -> None )
+  | Tree.Unary (_, Tree.IDENTITY, e) -> 
+      constant_integer e
+  | Tree.Binary (_, a, (Tree.ADD | Tree.SUB | Tree.MUL as op), b) ->
+      ( match constant_integer a, constant_integer b with
+        | Some i, Some j -> within (match op with Tree.ADD -> i + j | Tree.SUB -> i - j | _ -> i * j)
+        | _ -> None )
+  | _ -> 
+      None
+
+
+(* The shape of an array with the bounds pairs 'bounds', if they are all constants. 
+   Negative dimensions are left to the run-time error, and huge arrays to the
+   descriptor, so that the index arithmetic cannot overflow. *)
+
+let fixed_shape (bounds : (Tree.t * Tree.t) list) : fixed_array_t option =
+  let limit = 1 lsl 40 in
+  let constant_pair (l, u) = 
+    match constant_integer l, constant_integer u with
+    | Some l, Some u when u - l + 1 >= 0 -> Some (l, u)
+    | _ -> None
+  in
+  let pairs = List.map constant_pair bounds in
+  if List.exists (function None -> true | Some _ -> false) pairs then
+    None
+  else
+    let fixed_bounds = List.map (function Some pair -> pair | None -> assert false) pairs in
+    let stride (l, u) (strides, n) = 
+      let width = u - l + 1 in
+      (n :: strides, if width > 0 && n > limit / width then limit + 1 else n * width)
+    in
+    let strides, nelements = List.fold_right stride fixed_bounds ([], 1) in
+    if nelements > limit || List.exists2 (fun (l, _) s -> abs l > limit / (max s 1)) fixed_bounds strides then
+      None
+    else
+      let fixed_offset = List.fold_left2 (fun z (l, _) s -> z + l * s) 0 fixed_bounds strides in
+      Some { fixed_bounds = fixed_bounds; strides = strides; fixed_offset = fixed_offset; nelements = nelements }
+
+
+(* * Bounds check hoisting ------------------------------------------------------------------ *)
+
+(* Array subscripts of the form 'i', 'i + c', 'c + i' or 'i - c', where 'i' is
+   the control identifier of a FOR statement and 'c' is an integer constant,
+   can be bounds-checked for the whole range of the loop before the loop
+   starts. The FOR statement declares a flag for each such subscript, which
+   is true if every value the subscript can take is within the bounds of its
+   dimension; while the loop body is compiled these 'hoisted_check_t' records
+   tell 'designator_or_expression' that those flags can replace the
+   per-access checks.
+
+   A record only applies to the same array and the same control identifier
+   that it was made for. Those are recognised by the physical identity of the
+   array's definition and of the local scope that defines the control
+   identifier, so redeclarations inside the loop body are never confused with
+   them. Since the control identifier cannot be assigned to, and array bounds
+   do not change, the flags are valid throughout the loop body.
+
+   With the checks out of the loop, GCC's induction variable optimizations
+   take care of reducing the subscript multiplications to pointer
+   increments. *)
+
+type hoisted_check_t = {
+  array_defn    : Type.definition_t;  (* compared physically *)
+  control_scope : Scope.Local.t;      (* compared physically *)
+  dimension     : int;                (* counted from 0 *)
+  offset        : int;                (* the constant added to the control identifier *)
+  flag          : Code.t              (* C variable, true if the subscript is always in bounds *)
+}
+
+let hoisted_checks : hoisted_check_t list ref = ref []
+
+let hoisted_flag_counter = ref 0
+
+
+(* 'defining_local scope id' returns the local scope in which 'id' is defined. *)
+
+let rec defining_local (scope : Scope.t) (id : Id.t) : Scope.Local.t option =
+  match scope with
+  | [] -> None
+  | local :: outer ->
+      ( match Scope.Local.get local id with
+        | Some _ -> Some local
+        | None -> defining_local outer id )
+
+
+(* If 'subscript' is the identifier 'i' plus or minus an integer constant 'c', this returns Some (i, c). *)
+
+let affine_subscript (subscript : Tree.t) : (Id.t * int) option =
+  let constant s = 
+    try 
+      let c = int_of_string s in 
+      if abs c <= 1000000 then Some c else None
+    with Failure _ -> 
+      None
+  in
+  match subscript with
+  | Tree.Identifier (_, i) -> 
+      Some (i, 0)
+  | Tree.Binary (_, Tree.Identifier (_, i), Tree.ADD, Tree.Integer (_, s))
+  | Tree.Binary (_, Tree.Integer (_, s), Tree.ADD, Tree.Identifier (_, i)) ->
+      ( match constant s with Some c -> Some (i, c) | None -> None )
+  | Tree.Binary (_, Tree.Identifier (_, i), Tree.SUB, Tree.Integer (_, s)) ->
+      ( match constant s with Some c -> Some (i, - c) | None -> None )
+  | _ -> 
+      None
+
+
+(* 'hoist_array_checks scope body_scope control body first last' finds the array subscripts 
+   in the body of a FOR statement that can have their bounds checks hoisted out of the loop.
+   'scope' is the scope of the FOR statement, 'body_scope' is the scope of its body. 'first' 
+   and 'last' are C expressions for the lowest and highest values of the control identifier.
+   Returns the hoisted checks and the C declarations of their flags. *)
+
+let hoist_array_checks (scope : Scope.t) 
+                       (body_scope : Scope.t) 
+                       (control : Id.t) 
+                       (body : Tree.t)
+                       (first : Code.t)
+                       (last : Code.t)
+                       : hoisted_check_t list * Code.t =
+  let control_scope = List.hd body_scope in
+  let already_found checks defn k c =
+    List.exists (fun h -> h.array_defn == defn && h.dimension = k && h.offset = c) checks
+  in
+  let add_subscript array_id defn (checks, decls) k subscript =
+    match affine_subscript subscript with
+    | Some (i, c) when Id.eq i control && not (already_found checks defn k c) ->
+        incr hoisted_flag_counter;
+        let flag = Code.string (sprintf "_inrange%i" !hoisted_flag_counter) in
+        let check = { array_defn = defn; control_scope = control_scope; dimension = k; offset = c; flag = flag } in
+        let decl = 
+          match fixed_array array_id defn with
+          | Some fixed ->
+              let (lower, upper) = List.nth fixed.fixed_bounds k in
+              "const int $ = _awe_array_FIXED_IN_RANGE((long)$ + $, (long)$ + $, $, $);\n" $$
+                [flag; first; code_of_int c; last; code_of_int c; code_of_int lower; code_of_int upper]
+          | None ->
+              "const int $ = _awe_array_IN_RANGE($, $, (long)$ + $, (long)$ + $);\n" $$
+                [flag; Code.id array_id; code_of_int k; first; code_of_int c; last; code_of_int c]
+        in
+        (check :: checks, decls @$ decl)
+    | _ -> 
+        (checks, decls)
+  in
+  let rec scan found tree =
+    let found = 
+      match tree with
+      | Tree.Parametrized (_, id, actuals) ->
+          ( match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+            | Some (Array (_, ndims) as defn) 
+              when (ndims <= 3 || fixed_array id defn <> None) && List.length actuals = ndims ->
+                let found = ref found in
+                List.iteri (fun k subscript -> found := add_subscript id defn !found k subscript) actuals;
+                !found
+            | _ -> 
+                found )
+      | _ -> 
+          found
+    in
+    List.fold_left scan found (Tree.subtrees tree)
+  in
+  let checks, decls = scan ([], Code.empty) body in
+  (List.rev checks, decls)
+
+
+(* 'hoisted_flag scope array_defn k subscript' returns the C flag that proves 
+   'subscript' is within dimension 'k' of an array, if there is one. *)
+
+let hoisted_flag (scope : Scope.t) (array_defn : Type.definition_t) (k : int) (subscript : Tree.t) : Code.t option =
+  match affine_subscript subscript with
+  | Some (i, c) ->
+      ( match defining_local scope i with
+        | Some local ->
+            ( try
+                let h = List.find 
+                          (fun h -> h.array_defn == array_defn && h.control_scope == local 
+                                    && h.dimension = k && h.offset = c)
+                          !hoisted_checks 
+                in
+                Some h.flag
+              with Not_found -> 
+                None )
+        | None -> 
+            None )
+  | None -> 
+      None
+
+
+(* 'with_hoisted_checks checks f' calls 'f ()' with 'checks' in force. *)
+
+let with_hoisted_checks (checks : hoisted_check_t list) (f : unit -> 'a) : 'a =
+  let saved = !hoisted_checks in
+  hoisted_checks := checks @ saved;
+  try
+    let result = f () in
+    hoisted_checks := saved;
+    result
+  with e ->
+    hoisted_checks := saved;
+    raise e
+
+
+(* * Reference class facts -------------------------------------------------------------- *)
+
+(* Field designators check that their reference is not NULL, is initialized, and refers 
+   to a record of the field's class. Those checks are redundant where the reference is 
+   a variable that is known to refer to a record of that class: in the THEN branch of 
+   'IF r IS C', after 'r := C(...)', or after a statement that has already found a 
+   field of 'r'. 
+
+   'ref_facts' lists what is known about reference variables at the point being 
+   compiled. Facts are keyed by the physical identity of the variables' definitions, 
+   as with 'hoisted_check_t'. Only variables (including VALUE formals) are tracked,
+   a name parameter could be an alias for anything.
+
+   The facts are made conservatively, one statement of a block at a time. A statement
+   is compiled knowing only the facts that nothing in it can change, so a fact holds 
+   everywhere it is used, including in the bodies of loops. Anything that calls a 
+   procedure or a name parameter could assign to any variable, so it forgets all 
+   facts. So do labels, which can be reached from anywhere. Procedure bodies start 
+   knowing nothing. *)
+
+type ref_fact_t = {
+  fact_id    : Id.t;
+  fact_defn  : Type.definition_t;  (* compared physically *)
+  fact_class : Class.t             (* the class the variable is known to refer to *)
+}
+
+let ref_facts : ref_fact_t list ref = ref []
+
+
+(* The fact that 'id' refers to a record of 'record_class', if 'id' is a reference variable. *)
+
+let ref_fact (scope : Scope.t) (id : Id.t) (record_class : Class.t) : ref_fact_t list =
+  match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+  | Some (Variable (Reference _) as defn) -> [ { fact_id = id; fact_defn = defn; fact_class = record_class } ]
+  | _ -> []
+
+
+(* The class of the records that a record designator expression creates. *)
+
+let designated_class (scope : Scope.t) (tree : Tree.t) : Class.t option =
+  match tree with
+  | Tree.Identifier (_, id) | Tree.Parametrized (_, id, _) ->
+      ( match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+        | Some (Record (c, _)) -> Some c
+        | _ -> None )
+  | _ -> 
+      None
+
+
+exception Assigns_anything
+
+(* 'assigned_identifiers scope tree' returns the identifiers that 'tree' can assign to, 
+   or None if it could assign to anything. Identifiers that 'tree' declares itself, and 
+   identifiers that cannot be found in 'scope', are treated as possible procedures. *)
+
+let assigned_identifiers (scope : Scope.t) (tree : Tree.t) : Id.t list option =
+  let rec scan locals assigned tree =
+    let check id =
+      if not (List.exists (Id.eq id) locals) then
+        match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+        | Some (Procedure _ | Name _) | None -> raise Assigns_anything
+        | Some _ -> ()
+    in
+    let declared decl =
+      match decl with
+      | Tree.Simple (_, _, ids) | Tree.ARRAY (_, _, ids, _) -> ids
+      | Tree.RECORD (_, id, fields) -> 
+          id :: List.concat (List.map (function Tree.Simple (_, _, ids) -> ids | _ -> []) fields)
+      | _ -> raise Assigns_anything  (* i.e. a procedure declaration *)
+    in
+    match tree with
+    | Tree.Identifier (_, id) -> 
+        check id; 
+        assigned
+    | Tree.Parametrized (_, id, _) -> 
+        check id; 
+        List.fold_left (scan locals) assigned (Tree.subtrees tree)
+    | Tree.Assignment (_, Tree.Identifier (_, id), e) -> 
+        check id; 
+        scan locals (id :: assigned) e
+    | Tree.FOR (_, control, _, _, _) | Tree.FOR_step (_, control, _, _, _, _) | Tree.FOR_list (_, control, _, _) ->
+        List.fold_left (scan (control :: locals)) assigned (Tree.subtrees tree)
+    | Tree.BEGIN (_, decls, _, _) ->
+        let locals = List.concat (List.map declared decls) @ locals in
+        List.fold_left (scan locals) assigned (Tree.subtrees tree)
+    | _ -> 
+        List.fold_left (scan locals) assigned (Tree.subtrees tree)
+  in
+  try Some (scan [] [] tree) with Assigns_anything -> None
+
+
+(* The facts in 'facts' that still hold after 'tree' is executed, ignoring what 'tree' proves. *)
+
+let surviving_facts (scope : Scope.t) (facts : ref_fact_t list) (tree : Tree.t) : ref_fact_t list =
+  match assigned_identifiers scope tree with
+  | Some assigned -> List.filter (fun f -> not (List.exists (Id.eq f.fact_id) assigned)) facts
+  | None -> []
+
+
+(* The facts that are true if the condition 'tree' is true: its IS tests, 
+   including those joined by AND. *)
+
+let condition_facts (scope : Scope.t) (tree : Tree.t) : ref_fact_t list =
+  let rec tests tree =
+    match tree with
+    | Tree.Binary (_, Tree.Identifier (_, id), Tree.IS, Tree.Identifier (_, record_id)) ->
+        ( match (try Some (Scope.get scope record_id) with Scope.Undefined _ -> None) with
+          | Some (Record (c, _)) -> ref_fact scope id c
+          | _ -> [] )
+    | Tree.Binary (_, a, Tree.AND, b) -> 
+        tests a @ tests b
+    | _ -> 
+        []
+  in
+  match assigned_identifiers scope tree with
+  | Some [] -> tests tree
+  | _ -> []
+
+
+(* The facts that a branch or loop body controlled by 'condition' can be compiled with, 
+   in addition to those known before the condition. The statements of a block 
+   are compiled in sequence, each forgetting the facts it can change. *)
+
+let branch_facts (scope : Scope.t) (condition : Tree.t) (branch : Tree.t) : ref_fact_t list =
+  let facts = condition_facts scope condition in
+  match branch with
+  | Tree.BEGIN _ -> facts
+  | _ -> surviving_facts scope facts branch
+
+
+(* The facts known after the statement 'tree', if 'facts' were known before it. *)
+
+let facts_after (scope : Scope.t) (facts : ref_fact_t list) (tree : Tree.t) : ref_fact_t list =
+  let rec assignment_facts tree =
+    match tree with
+    | Tree.Assignment (_, Tree.Identifier (_, id), e) ->
+        let rec value e = match e with Tree.Assignment (_, _, e') -> value e' | _ -> e in
+        ( match designated_class scope (value e) with
+          | Some c -> ref_fact scope id c @ assignment_facts e
+          | None -> [] )
+    | Tree.Assignment (_, _, e) ->
+        assignment_facts e
+    | _ -> 
+        []
+  in
+  (* Field designators that are always evaluated by 'tree'. *)
+  let rec field_facts assigned tree =
+    match tree with
+    | Tree.IF _ | Tree.IF_else _ | Tree.CASE _ | Tree.CASE_expr _ | Tree.WHILE _ 
+    | Tree.FOR _ | Tree.FOR_step _ | Tree.FOR_list _ | Tree.BEGIN _ ->
+        []
+    | Tree.Binary (_, a, (Tree.AND | Tree.OR), _) -> 
+        field_facts assigned a
+    | Tree.Parametrized (_, field_id, [Tree.Identifier (_, id)]) 
+      when not (List.exists (Id.eq id) assigned) ->
+        ( match (try Some (Scope.get scope field_id) with Scope.Undefined _ -> None) with
+          | Some (Field (_, c)) -> ref_fact scope id c
+          | _ -> [] )
+    | _ -> 
+        List.concat (List.map (field_facts assigned) (Tree.subtrees tree))
+  in
+  let fields =
+    match assigned_identifiers scope tree with
+    | Some assigned -> field_facts assigned tree
+    | None -> []
+  in
+  assignment_facts tree @ fields @ surviving_facts scope facts tree
+
+
+(* 'proven_class scope tree c' is true if 'tree' is a variable known to refer to a record of class 'c'. *)
+
+let proven_class (scope : Scope.t) (tree : Tree.t) (record_class : Class.t) : bool =
+  match tree with
+  | Tree.Identifier (_, id) ->
+      ( match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+        | Some defn -> 
+            List.exists (fun f -> f.fact_defn == defn && Class.compare f.fact_class record_class = 0) !ref_facts
+        | None -> 
+            false )
+  | _ -> 
+      false
+
+
+(* 'with_ref_facts facts f' calls 'f ()' knowing only 'facts'. *)
+
+let with_ref_facts (facts : ref_fact_t list) (f : unit -> 'a) : 'a =
+  let saved = !ref_facts in
+  ref_facts := facts;
+  try
+    let result = f () in
+    ref_facts := saved;
+    result
+  with e ->
+    ref_facts := saved;
+    raise e
+
+
+(* * Lifted procedures ------------------------------------------------------------------------ *)
+
+(* Algol procedures are GNU C nested functions, but a procedure that uses nothing from the
+   blocks around it except other such procedures does not need to be nested. These are
+   "lifted" to file scope as static functions, which GCC can optimize like any other. 
+   They are given unique C names, because two blocks can declare procedures with the same
+   identifier, and the names are recorded in 'lifted_procedures'. 
+
+   Variables of the enclosing blocks are not moved to file scope or turned into extra 
+   parameters, so a procedure that uses any of them stays nested. *)
+
+let lifted_procedures : (Type.definition_t * Code.t) list ref = ref []  (* compared physically *)
+
+let lifted_procedure_counter = ref 0
+
+(* The procedures that stay nested. With -n they cannot be passed to PROCEDURE parameters. *)
+
+let nested_procedures : Type.definition_t list ref = ref []  (* compared physically *)
+
+
+(* The C function for the procedure 'id' in 'scope'. *)
+
+let procedure_c_id (scope : Scope.t) (id : Id.t) : Code.t =
+  match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+  | Some defn when List.mem_assq defn !lifted_procedures -> List.assq defn !lifted_procedures
+  | _ -> Code.id id
+
+
+(* * Name parameter closures ---------------------------------------------------------------- *)
+
+(* With the -n option name parameters are passed as "_awe_name" closures instead of
+   pointers to nested functions, see 'Name parameters' in "awe.h".
+
+   A name actual parameter that only uses variables, arrays, FOR control identifiers,
+   name parameters, lifted procedures and predeclared identifiers gets a thunk at file
+   scope. The caller fills an environment structure with pointers to its variables, and
+   the thunk is compiled in a scope where the captured variables are RESULT parameters,
+   arrays are array parameters, and so on. 'file_scope_code' collects these thunks, they
+   are written after the program headers. Any other actual parameter would need a nested
+   thunk function, and a trampoline for its address, so -n rejects it. *)
+
+let file_scope_code : Code.t ref = ref Code.empty
+
+let name_thunk_counter = ref 0
+
+exception Needs_nested_thunk
+
+
+(* 'name_captures scope tree' returns the identifiers that a file scope thunk for the
+   actual parameter 'tree' must capture, with their definitions, or None if the actual
+   parameter needs a nested thunk. *)
+
+let name_captures (scope : Scope.t) (tree : Tree.t) : (Id.t * Type.definition_t) list option =
+  let predeclared id defn =
+    try Scope.get Predeclared.scope id == defn with Scope.Undefined _ -> false
+  in
+  let by_value formal = match formal with By_value _ -> true | _ -> false in
+  let capture id =
+    match (try Scope.get scope id with Scope.Undefined _ -> raise Needs_nested_thunk) with
+    | Variable _ | Result _ | Control | Name _ | Array _ as defn ->
+        if predeclared id defn then [] else [(id, defn)]
+    | Analysis _ ->
+        []
+    | Procedure (_, formals) as defn when predeclared id defn && List.for_all by_value formals ->
+        []
+    | Procedure _ as defn when List.mem_assq defn !lifted_procedures ->
+        []
+    | _ ->
+        raise Needs_nested_thunk
+  in
+  let rec captures tree =
+    match tree with
+    | Tree.Integer _ | Tree.Bits _ | Tree.String _ | Tree.Real _ | Tree.Imaginary _
+    | Tree.LongReal _ | Tree.LongImaginary _ | Tree.TRUE _ | Tree.FALSE _ | Tree.NULL _ ->
+        []
+    | Tree.Identifier (_, id) ->
+        capture id
+    | Tree.Parametrized (_, id, actuals) ->
+        capture id @ List.concat (List.map captures actuals)
+    | Tree.Binary (_, reference, Tree.IS, _) ->  (* the right operand is a record class *)
+        captures reference
+    | Tree.Binary _ | Tree.Unary _ | Tree.Substring _ | Tree.IF_else _ | Tree.CASE_expr _ ->
+        List.concat (List.map captures (Tree.subtrees tree))
+    | _ ->
+        raise Needs_nested_thunk
+  in
+  let add_once ids (id, defn) =
+    if List.exists (fun (id', _) -> Id.eq id id') ids then ids else ids @ [(id, defn)]
+  in
+  try
+    Some (List.fold_left add_once [] (captures tree))
+  with Needs_nested_thunk ->
+    None
+
+
+(* * Direct name parameters ---------------------------------------------------------------- *)
+
+(* Most name parameters are used as though they were VALUE parameters, or as variables,
+   but every use of one calls a thunk. 
+
+   A procedure is "quiet" if its body cannot change anything outside itself, except through 
+   its name parameters: it assigns only to its own variables and name parameters, and calls 
+   no procedures except the predeclared ones. A quiet procedure gets a second C function, 
+   a clone that takes its read-only name parameters by value and its other name parameters 
+   as pointers. A call uses the clone if all of its name actual parameters allow it, see 
+   'direct_call_allowed', otherwise it uses the thunk version, as do procedure parameters.
+
+   During a call to a quiet procedure the values and addresses of the actual parameters 
+   cannot change, so evaluating them once at the call gives the same results as the thunks 
+   do, provided that evaluating them has no side effects, and either cannot fail or is 
+   certain to happen anyway. A name parameter is "strict" if the procedure always uses it, 
+   before any input or output. *)
+
+type direct_formal_t =
+  | Not_name                   (* passed as usual *)
+  | Name_by_value of bool      (* a read-only name parameter, true if it is strict *)
+  | Name_by_reference of bool  (* an assigned name parameter, true if it is strict *)
+
+type direct_procedure_t = {
+  direct_id    : Code.t;                (* the C function of the clone *)
+  direct_modes : direct_formal_t list   (* one for each formal parameter *)
+}
+
+(* The clones of quiet procedures, keyed by the procedures' definitions, compared physically. *)
+
+let direct_procedures : (Type.definition_t * direct_procedure_t) list ref = ref []
+
+exception Not_quiet
+
+
+(* The formal parameter that a clone has in place of 'formal', and the definition of the 
+   parameter in the clone's body. *)
+
+let direct_formal (formal : formal_t) (mode : direct_formal_t) : formal_t =
+  match formal, mode with
+  | By_name t, Name_by_value _     -> By_value t
+  | By_name t, Name_by_reference _ -> By_result t
+  | _,         _                   -> formal
+
+let direct_definition (formal : formal_t) (mode : direct_formal_t) : Type.definition_t option =
+  match formal, mode with
+  | By_name t, Name_by_value _     -> Some (Variable t)
+  | By_name t, Name_by_reference _ -> Some (Result t)
+  | _,         _                   -> None
+
+
+(* The C declaration of a variable 'var' for a formal parameter, as in 'add_formal_segment'. 
+   Procedure parameters are not handled. *)
+
+let formal_declaration (var : Code.t) (formal : formal_t) : Code.t =
+  match formal with
+  | By_value t -> 
+      "$ $" $$ [ctype t; var]
+  | By_result t | By_value_result t -> 
+      "$$" $$ [c_pointer_type t; var]
+  | By_name t when !Options.name_closures -> 
+      "_awe_name $" $$ [var]
+  | By_name (String n as t) when n > 1 -> 
+      "$($)(void)" $$ [c_pointer_type t; var]
+  | By_name t -> 
+      "$(*$)(void)" $$ [c_pointer_type t; var]
+  | By_array _ -> 
+      "_awe_array_t *$" $$ [var]
+  | By_procedure _ -> 
+      failwith "Compiler.formal_declaration: procedure parameters are not handled"
+
+
+(* The definitions of a procedure's formal parameters in its body, when they are passed 
+   as 'modes' says. *)
+
+let direct_locals (procedure : procedure_header_t) (modes : direct_formal_t list) : Scope.Local.t =
+  let redefine locals (id, (formal, mode)) =
+    match direct_definition formal mode with
+    | Some defn -> List.hd (Scope.redefine [locals] id defn)
+    | None      -> locals
+  in
+  List.fold_left redefine procedure.parameters.procedure_locals
+    (List.combine procedure.formal_ids (List.combine procedure.parameters.formal_types modes))
+
+
+(* The identifiers declared by a formal parameter segment. *)
+
+let formal_segment_ids (segment : Tree.t) : Id.t list =
+  match segment with
+  | Tree.Name_formal (_, _, ids) | Tree.VALUE_formal (_, _, ids) | Tree.RESULT_formal (_, _, ids) 
+  | Tree.VALUE_RESULT_formal (_, _, ids) | Tree.PROCEDURE_formal (_, _, ids, _) | Tree.ARRAY_formal (_, _, ids, _) -> 
+      ids
+  | _ -> 
+      []
+
+
+(* Every identifier declared anywhere in 'tree', including FOR control identifiers and the
+   formal parameters of the procedures declared in it. *)
+
+let rec declared_identifiers (tree : Tree.t) : Id.t list =
+  let here =
+    match tree with
+    | Tree.Simple (_, _, ids) | Tree.ARRAY (_, _, ids, _) -> ids
+    | Tree.FOR (_, id, _, _, _) | Tree.FOR_step (_, id, _, _, _, _) | Tree.FOR_list (_, id, _, _) -> [id]
+    | Tree.PROCEDURE (_, _, id, formals, _) -> id :: List.concat (List.map formal_segment_ids formals)
+    | Tree.RECORD (_, id, fields) -> id :: List.concat (List.map declared_identifiers fields)
+    | _ -> []
+  in
+  here @ List.concat (List.map declared_identifiers (Tree.subtrees tree))
+
+
+(* True if 'p' is true of 'tree' or any of its subtrees. *)
+
+let rec tree_exists (p : Tree.t -> bool) (tree : Tree.t) : bool =
+  p tree || List.exists (tree_exists p) (Tree.subtrees tree)
+
+
+(* 'direct_formal_modes scope formal_ids formals body' returns how each parameter of a procedure
+   would be passed to its clone, or None if the procedure is not quiet. 'scope' is the scope of 
+   the procedure's formal parameters. *)
+
+let direct_formal_modes (scope : Scope.t) (formal_ids : Id.t list) (formals : formal_t list) (body : Tree.t) 
+    : direct_formal_t list option =
+  let name_ids = 
+    List.concat (List.map2 (fun id f -> match f with By_name _ -> [id] | _ -> []) formal_ids formals) 
+  in
+  let copied_ids =  (* VALUE and RESULT parameters are the procedure's own variables *)
+    List.concat 
+      (List.map2 
+         (fun id f -> match f with By_value _ | By_result _ | By_value_result _ -> [id] | _ -> []) 
+         formal_ids formals) 
+  in
+  let rec procedures tree =
+    match tree with
+    | Tree.PROCEDURE (_, _, id, _, _) -> [id]
+    | _ -> List.concat (List.map procedures (Tree.subtrees tree))
+  in
+  let by_value f = match f with By_value _ -> true | _ -> false in
+  let member id ids = List.exists (Id.eq id) ids in
+  let strict_uses, writes, io, goto = ref [], ref [], ref false, ref false in
+  try
+    if name_ids = [] || List.exists (function By_procedure _ -> true | _ -> false) formals then 
+      raise Not_quiet ;
+    (* The body is compiled twice, but a record class must be declared once. *)
+    if tree_exists (function Tree.RECORD _ -> true | _ -> false) body then raise Not_quiet ;
+    let local_ids = declared_identifiers body in
+    if List.exists (fun id -> member id local_ids) name_ids then raise Not_quiet ;  (* hidden *)
+    let local_procedures = procedures body in
+    (* 'bound' are the identifiers declared by the blocks and FOR statements around a use. *)
+    let own bound id = member id bound || member id copied_ids in
+    let block_ids decls =
+      let declared decl =
+        match decl with
+        | Tree.Simple (_, _, ids) | Tree.ARRAY (_, _, ids, _) -> ids
+        | Tree.PROCEDURE (_, _, id, _, _) -> [id]
+        | _ -> []
+      in
+      List.concat (List.map declared decls)
+    in
+    let assign bound target =
+      match target with
+      | Tree.Identifier (_, id) | Tree.Substring (_, Tree.Identifier (_, id), _, _) ->
+          if member id name_ids then writes := id :: !writes
+          else if not (own bound id) then raise Not_quiet
+      | Tree.Parametrized (_, id, _) when member id bound && not (member id local_procedures) -> 
+          ()  (* an element of a local array *)
+      | _ -> 
+          raise Not_quiet
+    in
+    let use bound id =
+      if member id local_procedures then raise Not_quiet
+      else if own bound id || member id name_ids then ()
+      else 
+        match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+        | Some (Procedure (_, formals) as defn) 
+          when (try Scope.get Predeclared.scope id == defn with Scope.Undefined _ -> false)
+               && List.for_all by_value formals ->
+            ()
+        | Some (Standard _) -> io := true
+        | Some (Procedure _ | Name _) | None -> raise Not_quiet
+        | Some _ -> ()
+    in
+    let rec scan bound tree =
+      match tree with
+      | Tree.Identifier (_, id) -> 
+          use bound id
+      | Tree.Parametrized (_, id, actuals) ->
+          use bound id ;
+          ( match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+            | Some (Standard (Read | Readon | Readcard)) when not (own bound id) -> List.iter (assign bound) actuals
+            | _ -> () ) ;
+          List.iter (scan bound) actuals
+      | Tree.Assignment (_, target, e) ->
+          assign bound target ;
+          List.iter (scan bound) (Tree.subtrees target) ;
+          scan bound e
+      | Tree.Binary (_, reference, Tree.IS, _) -> 
+          scan bound reference
+      | Tree.BEGIN (_, decls, statements, _) ->
+          let inner = block_ids decls @ bound in
+          List.iter (fun decl -> scan (match decl with Tree.ARRAY _ -> bound | _ -> inner) decl) decls ;
+          List.iter (scan inner) statements
+      | Tree.FOR (_, control, a, b, body) ->
+          scan bound a ; scan bound b ; scan (control :: bound) body
+      | Tree.FOR_step (_, control, a, b, c, body) ->
+          scan bound a ; scan bound b ; scan bound c ; scan (control :: bound) body
+      | Tree.FOR_list (_, control, es, body) ->
+          List.iter (scan bound) es ; scan (control :: bound) body
+      | Tree.GOTO _ -> 
+          goto := true
+      | Tree.PROCEDURE _ ->  
+          ()  (* only runs if it is called, which is not quiet *)
+      | _ -> 
+          List.iter (scan bound) (Tree.subtrees tree)
+    in
+    (* The identifiers that are always evaluated when 'tree' is. *)
+    let rec strict tree =
+      match tree with
+      | Tree.Identifier (_, id) -> [id]
+      | Tree.Binary (_, a, (Tree.AND | Tree.OR | Tree.IS), _) -> strict a
+      | Tree.IF (_, c, _) | Tree.IF_else (_, c, _, _) | Tree.CASE (_, c, _) | Tree.CASE_expr (_, c, _)
+      | Tree.WHILE (_, c, _) | Tree.FOR_list (_, _, c :: _, _) -> strict c
+      | Tree.FOR (_, _, a, b, _) -> strict a @ strict b
+      | Tree.FOR_step (_, _, a, b, c, _) -> strict a @ strict b @ strict c
+      | Tree.Parametrized _ | Tree.Assignment _ | Tree.Substring _ | Tree.Binary _ | Tree.Unary _
+      | Tree.BEGIN _ | Tree.ARRAY _ -> List.concat (List.map strict (Tree.subtrees tree))
+      | _ -> []
+    in
+    scan [] body ;
+    if not (!io || !goto) then strict_uses := strict body ;
+    Some (List.map2 
+            (fun id f -> 
+               match f with
+               | By_name _ when member id !writes -> Name_by_reference (member id !strict_uses)
+               | By_name _ -> Name_by_value (member id !strict_uses)
+               | _ -> Not_name)
+            formal_ids formals)
+  with Not_quiet -> 
+    None
+
+
+(* * Procedure inlining ----------------------------------------------------------------------- *)
+
+(* With the -O option calls to small procedures are compiled in place, as GNU C statement
+   expressions, instead of as calls to nested functions. The procedure's body is compiled 
+   again for each call, in the scope of the procedure declaration, and its formal parameters 
+   become C variables initialized with the arguments the C function would have been passed. 
+   So VALUE, RESULT and name parameters behave as they do in a call.
+
+   The body's C code is only correct at a call if the identifiers it uses mean the same 
+   thing there as they do at the procedure declaration, 'inline_call_allowed' checks this.
+
+   Procedures are not inlined if they are recursive, declare procedures or records, have
+   procedure parameters, return strings, or have more than 'inline_budget' parse tree nodes. *)
+
+let inline_budget = 40
+
+(* The procedures that can be inlined, keyed by their definitions (compared physically), 
+   with the scopes of their declarations. *)
+
+let inline_procedures : (Type.definition_t * (procedure_header_t * Scope.t)) list ref = ref []
+
+let inlining : Type.definition_t list ref = ref []  (* the procedures being inlined now *)
+
+
+let rec tree_size (tree : Tree.t) : int =
+  List.fold_left (fun n t -> n + tree_size t) 1 (Tree.subtrees tree)
+
+
+(* True if 'procedure' is small and simple enough to be inlined. *)
+
+let inlinable (procedure : procedure_header_t) : bool =
+  let calls_itself = 
+    tree_exists 
+      (function 
+        | Tree.Identifier (_, id) | Tree.Parametrized (_, id, _) -> Id.eq id procedure.proc_id 
+        | _ -> false) 
+      procedure.body 
+  in
+  let declares_procedures_or_records = 
+    tree_exists (function Tree.PROCEDURE _ | Tree.RECORD _ -> true | _ -> false) procedure.body 
+  in
+  let external = match procedure.body with Tree.External _ -> true | _ -> false in
+  let returns_string = match procedure.returntype with String n -> n > 1 | _ -> false in
+  let procedure_parameters = 
+    List.exists (function By_procedure _ -> true | _ -> false) procedure.parameters.formal_types 
+  in
+  !Options.inline_procedures 
+  && not !Options.add_tracing_hooks
+  && not (external || calls_itself || declares_procedures_or_records || returns_string || procedure_parameters)
+  && tree_size procedure.body <= inline_budget
+
+
+(* 'inline_call_allowed procedure declaration_scope scope' is true if the identifiers used 
+   in the body of 'procedure', which was declared in 'declaration_scope', have the same 
+   definitions in 'scope'. *)
+
+let inline_call_allowed (procedure : procedure_header_t) (declaration_scope : Scope.t) (scope : Scope.t) : bool =
+  let rec used tree =
+    let here =
+      match tree with
+      | Tree.Identifier (_, id) | Tree.Parametrized (_, id, _) | Tree.GOTO (_, id) -> [id]
+      | _ -> []
+    in
+    here @ List.concat (List.map used (Tree.subtrees tree))
+  in
+  let same id =
+    List.exists (Id.eq id) procedure.formal_ids ||
+    match (try Some (Scope.get declaration_scope id) with Scope.Undefined _ -> None) with
+    | Some defn -> (try Scope.get scope id == defn with Scope.Undefined _ -> false)
+    | None      -> true  (* declared in the body *)
+  in
+  List.for_all same (used procedure.body)
+
+
+(* * External procedures ---------------------------------------------------------------------- *)
+
+(* The procedures declared with external references. They may be C functions that write to
+   the standard output or error stream themselves, but the runtime library keeps each line
+   of ALGOL W output in a buffer until the line is complete, so calls to them are preceded 
+   by a call to '_awe_flush_printers', to keep the output in order. *)
+
+let external_procedures : Type.definition_t list ref = ref []  (* compared physically *)
+
+
+(* * String results ------------------------------------------------------------------------- *)
+
+(* A procedure that returns a string of more than one character is given the address of 
+   the string to build its result in, as a hidden first C argument, '_awe_result'. This 
+   replaces copying the result into '_awe_return_string' and then out again.
+
+   Declaration:  STRING(10) PROCEDURE F (INTEGER VALUE N); BEGIN ... END;
+   C header:     _awe_str f (_awe_str _awe_result, int n)
+   Algol calls:  S := F(1);     WRITE(F(2))
+   C calls:      f(s, 1);       ... ({ struct { unsigned char s[10]; } _awe_result_1; 
+                                       f(_awe_result_1.s, 2); _awe_result_1; }).s ...
+
+   An assignment to a string variable of the same length passes the variable, unless the
+   call has RESULT parameters to copy back afterwards or its actual parameters use the 
+   variable; then the result is built in an array of the call's own and copied into the 
+   variable after the call. Other calls pass an array of their own too. It is an automatic
+   array in a statement expression, so recursive calls such as F(N - 1) = F(N - 2) each
+   have one. The statement expression's value is a copy of a structure containing it, 
+   because a pointer to the array itself would not outlive the statement expression. 
+   If the procedure's body is a block, the block's value is copied straight into 
+   '_awe_result'.
+
+   This is not done for procedures that may be called from C code that knows nothing 
+   of it: external and separately compiled procedures, and procedures that are passed 
+   as actual parameters, which are called through PROCEDURE parameters. *)
+
+let string_result_procedures : (Type.definition_t * procedure_header_t) list ref = ref []  (* compared physically *)
+
+let string_result_counter = ref 0
+
+(* The variable and destination for the next procedure call compiled, set by an assignment. *)
+
+let call_destination : (Id.t * Code.t) option ref = ref None
+
+(* The destination and length for the value of the next block compiled, set for a procedure body. *)
+
+let block_destination : (Code.t * int) option ref = ref None
+
+let has_string_result (procedure : procedure_header_t) : bool =
+  List.exists (fun (_, p) -> p == procedure) !string_result_procedures
+
+
+(* The identifiers passed as actual parameters anywhere in 'tree'. *)
+
+let rec actual_identifiers (tree : Tree.t) : Id.t list =
+  let here =
+    match tree with
+    | Tree.Parametrized (_, _, actuals) -> 
+        List.concat (List.map (function Tree.Identifier (_, id) -> [id] | _ -> []) actuals)
+    | _ -> 
+        []
+  in
+  here @ List.concat (List.map actual_identifiers (Tree.subtrees tree))
+
+
+(* True if 'variable_id := procedure_id(...)' can pass the variable as the procedure's destination. *)
+
+let string_result_assignment (scope : Scope.t) (variable_id : Id.t) (procedure_id : Id.t) : bool =
+  let defn id = try Some (Scope.get scope id) with Scope.Undefined _ -> None in
+  match defn variable_id, defn procedure_id with
+  | Some (Variable (String n)), Some (Procedure (String m, _) as p) -> 
+      n = m && List.mem_assq p !string_result_procedures
+  | _, _ -> 
+      false
+
+
+(* The C header of the function 'c_id' for 'procedure'. *)
+
+let procedure_c_header (procedure : procedure_header_t) (c_id : Code.t) : Code.t =
+  let arguments =
+    if has_string_result procedure then 
+      Code.string "_awe_str _awe_result" @$. procedure.parameters.arguments
+    else 
+      procedure.parameters.arguments
+  in
+  if arguments = Code.empty then 
+    "$ $ (void)" $$ [ctype procedure.returntype; c_id] 
+  else 
+    "$ $ ($)" $$ [ctype procedure.returntype; c_id; arguments]
+
+
+(* The identifiers that 'tree' uses but does not declare, given that 'bound' are declared 
+   around it. The record class operands of IS are only class numbers in C, they are left out. *)
+
+let rec free_identifiers (bound : Id.t list) (tree : Tree.t) : Id.t list =
+  let free id = if List.exists (Id.eq id) bound then [] else [id] in
+  match tree with
+  | Tree.Identifier (_, id) | Tree.GOTO (_, id) -> 
+      free id
+  | Tree.Parametrized (_, id, actuals) -> 
+      free id @ List.concat (List.map (free_identifiers bound) actuals)
+  | Tree.Binary (_, reference, Tree.IS, _) -> 
+      free_identifiers bound reference
+  | Tree.BEGIN (_, decls, statements, _) ->
+      let declared decl =
+        match decl with
+        | Tree.Simple (_, _, ids) | Tree.ARRAY (_, _, ids, _) -> ids
+        | Tree.PROCEDURE (_, _, id, _, _) -> [id]
+        | Tree.RECORD (_, id, fields) -> id :: List.concat (List.map declared_identifiers fields)
+        | _ -> []
+      in
+      let labels = List.concat (List.map (function Tree.Label (_, id) -> [id] | _ -> []) statements) in
+      let inner = List.concat (List.map declared decls) @ labels @ bound in
+      let free_in_decl decl =
+        match decl with
+        | Tree.ARRAY _ -> free_identifiers bound decl  (* the bounds are evaluated outside the block *)
+        | _ -> free_identifiers inner decl
+      in
+      List.concat (List.map free_in_decl decls) @ List.concat (List.map (free_identifiers inner) statements)
+  | Tree.PROCEDURE (_, _, _, formals, body) ->
+      free_identifiers (List.concat (List.map formal_segment_ids formals) @ bound) body
+  | Tree.FOR (_, control, a, b, body) -> 
+      free_identifiers bound a @ free_identifiers bound b @ free_identifiers (control :: bound) body
+  | Tree.FOR_step (_, control, a, b, c, body) -> 
+      free_identifiers bound a @ free_identifiers bound b @ free_identifiers bound c 
+      @ free_identifiers (control :: bound) body
+  | Tree.FOR_list (_, control, es, body) -> 
+      List.concat (List.map (free_identifiers bound) es) @ free_identifiers (control :: bound) body
+  | _ -> 
+      List.concat (List.map (free_identifiers bound) (Tree.subtrees tree))
+
+
+(* 'liftable_procedures scope procedures' returns the procedures of a block that can be
+   lifted to file scope. 'scope' is the block's scope. A procedure can be lifted if each 
+   identifier it uses is predeclared, already lifted, or another of the block's procedures
+   that can be lifted. This is found by discarding procedures until none are left to discard. *)
+
+let liftable_procedures (scope : Scope.t) (procedures : procedure_header_t list) : procedure_header_t list =
+  let allowed candidates id =
+    match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with
+    | Some defn ->
+        (try Scope.get Predeclared.scope id == defn with Scope.Undefined _ -> false)
+        || List.mem_assq defn !lifted_procedures
+        || List.exists (fun p -> Id.eq p.proc_id id) candidates
+    | None -> 
+        false
+  in
+  let liftable candidates procedure =
+    List.for_all (allowed candidates) (free_identifiers procedure.formal_ids procedure.body)
+  in
+  let rec fixpoint candidates =
+    let remaining = List.filter (liftable candidates) candidates in
+    if List.length remaining = List.length candidates then candidates else fixpoint remaining
+  in
+  fixpoint (List.filter (fun p -> match p.body with Tree.External _ -> false | _ -> true) procedures)
+
+
+(* * Specialized procedures ------------------------------------------------------------------ *)
+
+(* With the -O option, a call that passes lifted procedures to the PROCEDURE parameters of a 
+   lifted procedure uses a clone of it, compiled with those parameters bound to the actual 
+   procedures. The calls through the parameters become direct calls in the clone, and so can 
+   be inlined. For example:
+
+   Declarations:  REAL PROCEDURE SQUARE (REAL VALUE X); X * X;
+                  REAL PROCEDURE SUM (REAL PROCEDURE F; INTEGER VALUE N); ...F(I)...;
+   Algol call:    SUM(SQUARE, 10)
+   C call:        _awe_proc_2_sum_spec1(_awe_proc_1_square, 10)
+
+   The clone keeps all of the procedure's C arguments, it ignores the bound ones. The clones
+   are static functions at file scope like the lifted procedures. There are at most 
+   'specialization_limit' clones of each procedure, other calls use the procedure itself.
+
+   Calls with name parameters are not specialized by the expressions passed to them. *)
+
+let specialization_limit = 4
+
+(* The lifted procedures that can be specialized, keyed by their definitions (compared 
+   physically), with the scopes of their declarations. *)
+
+let specializable_procedures : (Type.definition_t * (procedure_header_t * Scope.t)) list ref = ref []
+
+(* The clones made so far: the procedure's definition, the actual procedure definition bound to 
+   each of its formal parameters (if any), and the clone's C function. *)
+
+let specializations : (Type.definition_t * (Type.definition_t option list * Code.t)) list ref = ref []
+
+let specialization_counter = ref 0
+
+
+(* * Read-only string parameters ------------------------------------------------------------ *)
+
+(* A STRING VALUE actual parameter is normally copied into a temporary at the point of call. 
+   If the procedure never assigns to the parameter, and the actual parameter is a constant or
+   a variable that nothing can change during the call, the call passes a pointer to it instead:
+
+   Declaration:  PROCEDURE P (STRING(80) VALUE CARD); ...
+   Algol call:   P(LINE)
+   C call:       p(line);
+
+   'readonly_string_formals' records which of a procedure's parameters are STRING VALUE
+   parameters that it never assigns to. A parameter is taken to be assigned to if it is the 
+   target of an assignment, or an actual parameter to anything but a VALUE parameter of a 
+   procedure, a WRITE or a standard function. Procedures declared inside the procedure's
+   body are not looked up, they are taken to assign to it. *)
+
+let readonly_string_formals : (Type.definition_t * bool list) list ref = ref []  (* compared physically *)
+
+
+let rec designator_root (tree : Tree.t) : Id.t option =
+  match tree with
+  | Tree.Identifier (_, id)       -> Some id
+  | Tree.Substring (_, d, _, _)   -> designator_root d
+  | _                             -> None
+
+
+(* 'readonly_formals scope procedure' is the list for 'readonly_string_formals', 'scope' is
+   the scope of the procedure's formal parameters. Identifiers declared in the procedure's 
+   body are unknown, so formal parameters passed to its own procedures count as assigned. *)
+
+let readonly_formals (scope : Scope.t) (procedure : procedure_header_t) : bool list =
+  (* An identifier declared in the body may not mean what it does in 'scope'. *)
+  let local_ids = declared_identifiers procedure.body in
+  let defn id = 
+    if List.exists (Id.eq id) local_ids then None
+    else try Some (Scope.get scope id) with Scope.Undefined _ -> None 
+  in
+  let rec assigned formal_id tree =
+    let is_formal actual = 
+      match designator_root actual with Some id -> Id.eq id formal_id | None -> false 
+    in
+    let passed_readonly formal = match formal with By_value _ -> true | _ -> false in
+    match tree with
+    | Tree.Assignment (_, target, _) when is_formal target -> 
+        true
+    | Tree.Parametrized (_, id, actuals) when List.exists is_formal actuals ->
+        let readonly =
+          match defn id with
+          | Some (Procedure (_, formals)) when List.length formals = List.length actuals ->
+              List.for_all2 (fun formal actual -> not (is_formal actual) || passed_readonly formal) formals actuals
+          | Some (Standard (Write | Writeon)) | Some (Analysis _) -> 
+              true
+          | _ -> 
+              false
+        in
+        not readonly || List.exists (assigned formal_id) actuals
+    | _ -> 
+        List.exists (assigned formal_id) (Tree.subtrees tree)
+  in
+  List.map2 
+    (fun id formal ->
+       match formal with
+       | By_value (String n) when n > 1 -> not (assigned id procedure.body)
+       | _ -> false)
+    procedure.formal_ids 
+    procedure.parameters.formal_types
+
+
+(* 'unchangeable_actual scope procedure_id actuals actual n' is true if the STRING(n) 'actual' 
+   can be passed by pointer to a read-only parameter of 'procedure_id', called with 'actuals'.
+   A variable can only be changed during the call if the procedure can see it, or if another
+   actual parameter uses it or a procedure that might change it. So a variable declared in a
+   block inside the one that declares the procedure is safe if the other actual parameters
+   use neither. *)
+
+let unchangeable_actual (scope : Scope.t) (procedure_id : Id.t) (actuals : Tree.t list) (actual : Tree.t) (n : int) : bool =
+  let defn id = try Some (Scope.get scope id) with Scope.Undefined _ -> None in
+  let rec depth scope id =
+    match scope with
+    | [] -> max_int
+    | local :: outer -> 
+        ( match Scope.Local.get local id with 
+          | Some _ -> 0 
+          | None -> 1 + depth outer id )
+  in
+  let predeclared id d = try Scope.get Predeclared.scope id == d with Scope.Undefined _ -> false in
+  let risky variable_id id =
+    Id.eq id variable_id || 
+    ( match defn id with Some (Procedure _ as d) -> not (predeclared id d) | _ -> false )
+  in
+  match actual with
+  | Tree.String (_, s) -> 
+      String.length s = n
+  | Tree.Identifier (_, variable_id) ->
+      ( match defn variable_id with
+        | Some (Variable (String m)) when m = n ->
+            depth scope variable_id < depth scope procedure_id &&
+            not (List.exists 
+                   (fun other -> other != actual && List.exists (risky variable_id) (free_identifiers [] other))
+                   actuals)
+        | _ -> 
+            false )
+  | _ -> 
+      false
+
+
+(* * Fused WRITE statements ------------------------------------------------------------------ *)
+
+(* A WRITE or WRITEON statement whose actual parameters are all quiet expressions becomes a 
+   single call to '_awe_write_fields', with a static array describing the fields and an array 
+   of their values. Nothing the statement does can change the editing variables, so they are 
+   not saved and restored. For example:
+
+   Algol statement:  WRITE("N =", N, X)
+   C statement:      { static const _awe_Write_field_t _awe_fields[] = {{'s', 3}, {'i', 0}, {'r', 0}};
+                       _awe_write_fields(_awe_at(<location>), 1, 3, _awe_fields, 
+                                         (const _awe_Write_value_t[]){{.s = "N ="}, {.i = n}, {.r = x}});
+                     }
+
+   A quiet expression is a constant, perhaps signed, or a simple variable or FOR control 
+   identifier. It cannot fail or change anything, so it makes no difference that all of 
+   the values are computed before the first field is written, in no particular order. 
+   Statements with any other actual parameters, which may fail with a runtime error after 
+   some fields have been written, are compiled one field at a time. *)
+
+let quiet_expression (scope : Scope.t) (tree : Tree.t) : bool =
+  let constant tree =
+    match tree with
+    | Tree.Integer _ | Tree.Bits _ | Tree.String _ 
+    | Tree.Real _ | Tree.Imaginary _ | Tree.LongReal _ | Tree.LongImaginary _ 
+    | Tree.TRUE _ | Tree.FALSE _ | Tree.NULL _ -> true
+    | _ -> false
+  in
+  match tree with
+  | Tree.Identifier (_, id) ->
+      ( match (try Some (Scope.get scope id) with Scope.Undefined _ -> None) with 
+        | Some (Variable _ | Result _ | Control) -> true 
+        | _ -> false )
+  | Tree.Unary (_, (Tree.NEG | Tree.IDENTITY), operand) ->
+      constant operand
+  | _ -> 
+      constant tree
+
+
 (* * Programs ---------------------------------------------------------------------------- *)
 
 (* The combined type checking and code generation pass is one huge recursive function 
@@ -524,7 +1744,13 @@ let rec program (tree : Tree.t) : Code.t =
   if program_expr.t <> Statement then
     error (Tree.to_loc tree) "a program should be a statement, this returns %s" (describe_simple program_expr.t)
   else
+    (* The headers and tables are made once all the code that adds to them has been made. *)
+    let headers = c_program_headers tree in
+    let table = location_table () in
+    let file_scope = !file_scope_code in
     "$
+     $
+     $
      $
      int _awe_argc;
      char **_awe_argv;
@@ -536,7 +1762,7 @@ let rec program (tree : Tree.t) : Code.t =
        _awe_finalize($);
        return 0;
      }
-     \n" $$ [ notice; c_program_headers tree; loc; program_expr.c; loc ]
+     \n" $$ [ notice; headers; table; file_scope; loc; program_expr.c; loc ]
 
 
 (* A separately compiled Algol procedure contains just headers and a C function. *)
@@ -546,8 +1772,11 @@ and separate_procedure (procedure : Tree.t) : Code.t =
   | Tree.PROCEDURE (_, _, _, _, _) -> 
       let block = {empty_block with scope = Predeclared.scope} in
       let block = add_procedure_declaration procedure block in
-      let block = add_procedure_functions block in
-      "$\n$\n$\n" $$ [notice; c_program_headers procedure; block.functions]
+      let block = add_procedure_functions block [] in
+      let headers = c_program_headers procedure in
+      let table = location_table () in
+      let file_scope = !file_scope_code in
+      "$\n$\n$\n$\n$\n" $$ [notice; headers; table; file_scope; block.functions]
   | _ -> 
       failwith "separate_procedure"
 
@@ -649,21 +1878,33 @@ and block_expression (scope : Scope.t)
                      (block_body : Tree.t list)  (* statements, labels *)
                      : typed_code_t =
 
+  let entry_facts = !ref_facts in
+  let destination = !block_destination in  (* see 'string_result_procedures' *)
+  block_destination := None ;
   let block = {empty_block with scope = Scope.push scope} in  
 
   (* Compose the declaration scans: *)
   let block = add_record_headers block block_head in
   let block = List.fold_left add_declaration block block_head in
   let block = add_label_declarations block block_body in
-  let block = add_procedure_functions block in
+  let block = add_procedure_functions block (block_head @ block_body) in
+
+  (* Each statement is compiled knowing the reference class facts that it cannot change, 
+     then the facts are brought up to date. See 'ref_facts'. *)
+  let in_sequence compile item =
+    let facts = !ref_facts in
+    let code = with_ref_facts (surviving_facts block.scope facts item) (fun () -> compile item) in
+    ref_facts := facts_after block.scope facts item;
+    code
+  in
 
   if block_body = [] then failwith "Compiler.block_expression: no block body" ;
   let statement_items, return_expression = snip_last block_body in
   let c_statements =
     List.map
       ( function
-          | Tree.Label (_, id) -> "$:\n" $$ [Code.id id]
-          | statement          -> expression_expect Statement block.scope statement )
+          | Tree.Label (_, id) -> ref_facts := []; "$:\n" $$ [Code.id id]
+          | statement          -> in_sequence (expression_expect Statement block.scope) statement )
       statement_items
   in
   let body = Code.concat [ block.labels;
@@ -674,12 +1915,16 @@ and block_expression (scope : Scope.t)
                            block.initialization;
                            Code.concat c_statements ]
   in
-  let return_value = expression block.scope return_expression in
+  let return_value = in_sequence (expression block.scope) return_expression in
   let inside_block = 
     if return_value.t = Statement then 
       "{\n$$}" $$ [body; return_value.c]
     else 
-      "({ $ $; })" $$ [ body; copy_if_string return_value]
+      match destination, return_value.t with
+      | Some (d, n), String m when m = n -> 
+          "({ $ _awe_string_into($, $, $); })" $$ [ body; d; return_value.c; code_of_int n ]
+      | _, _ -> 
+          "({ $ $; })" $$ [ body; copy_if_string return_value]
   in
   let outside_block = 
     if block.outsidescope = Code.empty then 
@@ -687,6 +1932,7 @@ and block_expression (scope : Scope.t)
     else
       (if return_value.t = Statement then "{\n$$\n}\n" else "({\n$$;\n})") $$ [ block.outsidescope; inside_block ]
   in
+  ref_facts := entry_facts;
   {t = return_value.t; c = outside_block}
 
 
@@ -778,7 +2024,7 @@ and expression (scope : Scope.t) (tree : Tree.t) : typed_code_t =
            {t = Logical; c = Code.string "0"} (* NULL never refers to a record *)
         | Reference class_set  ->
            if ClassSet.mem record_class class_set then  (* test at runtime *)
-             {t = Logical; c = "_awe_is($, $)" $$ [rc.c; Code.id (Class.to_id record_class)]}
+             {t = Logical; c = "_awe_is($, $)" $$ [rc.c; code_of_int (Class.number record_class)]}
            else 
              error loc "%s will never refer to a RECORD %s" (describe_simple rc.t) (Id.to_string record_id)
         | _ ->
@@ -802,14 +2048,17 @@ and expression (scope : Scope.t) (tree : Tree.t) : typed_code_t =
 
   | Tree.IF (loc, condition, then_clause) -> 
       let cc = expression_expect Logical scope condition in
-      let ct = expression_expect Statement scope then_clause in 
+      let ct = 
+        with_ref_facts (branch_facts scope condition then_clause @ !ref_facts) 
+          (fun () -> expression_expect Statement scope then_clause)
+      in 
       { t = Statement; 
         c = "if ($)\n $" $$ [cc; ct] }
 
   | Tree.IF_else (loc, condition, then_clause, else_clause) ->
       let cc = expression_expect Logical scope condition in
       let ce = expression scope else_clause in
-      let ct = expression scope then_clause in
+      let ct = with_ref_facts (branch_facts scope condition then_clause @ !ref_facts) (fun () -> expression scope then_clause) in
       let rtype =  
         try
           Type.triplet_rule ct.t ce.t
@@ -894,37 +2143,60 @@ and expression (scope : Scope.t) (tree : Tree.t) : typed_code_t =
 
   | Tree.WHILE (loc, condition, then_clause) -> 
       let cc = expression_expect Logical scope condition in
-      let ct = expression_expect Statement scope then_clause in
+      let ct = 
+        with_ref_facts (branch_facts scope condition then_clause @ !ref_facts) 
+          (fun () -> expression_expect Statement scope then_clause)
+      in
       { t = Statement; 
         c = "while ($)\n $ \n" $$ [cc; ct] }
 
   (* The limit and step expression of FOR statments are placed in
      temporary variables to prevent them from being called more than once. *)
 
+  (* Array subscripts that depend on the control identifier can have their bounds 
+     checks hoisted out of the loop, see 'hoist_array_checks'. *)
+
   | Tree.FOR (loc, control, first, last, body) -> 
       let ccontrol = Code.id control in
+      let cfirst = expression_expect integer scope first in
+      let clast = expression_expect integer scope last in
       let for_body_scope = set loc (Scope.push scope) control Control in
+      let checks, cchecks = 
+        hoist_array_checks scope for_body_scope control body (Code.string "_start") (Code.string "_limit") 
+      in
+      let cbody = with_hoisted_checks checks (fun () -> expression_expect Statement for_body_scope body) in
       { t = Statement;
         c = 
           "{ 
              const int _start = $;
              const int _limit = $;
+             $
              int $ = _start;
              while ($ <= _limit) {
                $
                ++$;
              }
            }
-          " $$ [   expression_expect integer scope first; 
-                  expression_expect integer scope last; 
+          " $$ [  cfirst; 
+                  clast; 
+                  cchecks;
                   ccontrol; 
                   ccontrol; 
-                  expression_expect Statement for_body_scope body; 
+                  cbody; 
                   ccontrol ] }
 
   | Tree.FOR_step (loc, control, first, step, last, body) -> 
       let ccontrol = Code.id control in
+      let cfirst = expression_expect integer scope first in
+      let cstep = expression_expect integer scope step in
+      let clast = expression_expect integer scope last in
       let for_body_scope = set loc (Scope.push scope) control Control in
+      let checks, cchecks = 
+        hoist_array_checks scope for_body_scope control body 
+          (Code.string "(_step > 0 ? _start : _limit)") 
+          (Code.string "(_step > 0 ? _limit : _start)") 
+      in
+      let cbody = with_hoisted_checks checks (fun () -> expression_expect Statement for_body_scope body) in
       { t = Statement;
         c = 
           "{
@@ -933,18 +2205,20 @@ and expression (scope : Scope.t) (tree : Tree.t) : typed_code_t =
              const int _limit = $;
              int $ = _start;
              _awe_check_for_step($, _step);
+             $
              while (_step > 0 ? $ <= _limit : $ >= _limit) {
                $
                $ += _step;
              }
            }
-          " $$ [ expression_expect integer scope first; 
-                 expression_expect integer scope step; 
-                 expression_expect integer scope last; 
+          " $$ [ cfirst; 
+                 cstep; 
+                 clast; 
                  ccontrol;
                  code_of_loc loc;
+                 cchecks;
                  ccontrol; ccontrol; 
-                 expression_expect Statement for_body_scope body; 
+                 cbody; 
                  ccontrol ] }
 
   (* As far as I can tell, all of the expressions in the list form of
@@ -996,6 +2270,15 @@ and expression (scope : Scope.t) (tree : Tree.t) : typed_code_t =
 
 (* ** Assignment expressions: ":="  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - *)
 
+  | Tree.Assignment (_, (Tree.Identifier (_, variable_id) as desig), 
+                     (Tree.Identifier (_, procedure_id) | Tree.Parametrized (_, procedure_id, _) as expr))
+    when string_result_assignment scope variable_id procedure_id ->
+      (* The procedure builds its result in the variable, see 'string_result_procedures'. *)
+      let variable = designator Lvalue scope desig in
+      call_destination := Some (variable_id, variable.c) ;
+      { t = Statement;
+        c = "$;\n" $$ [(expression scope expr).c] }
+
   | Tree.Assignment (loc, desig, expr) -> 
       let rec multiple_assignment loc' desig' expr' =
         let ecode = 
@@ -1415,6 +2698,9 @@ and procedure_call (loc : Location.t)
                    (actuals : Tree.t list)
                    : typed_code_t =
 
+  let destination = !call_destination in  (* see 'string_result_procedures' *)
+  call_destination := None ;
+
   (* List of (temporary variable name, actual parameter code, formal parameter type) 
      for each parameter in the procedure call.*)
   let parameter_info : (Code.t * Tree.t * Type.formal_t) list =
@@ -1435,38 +2721,371 @@ and procedure_call (loc : Location.t)
     else call
   in
 
-  let call = add_tracing (List.fold_left (add_call_parameter scope) empty_actual_parameters parameter_info) in
+  (* External procedures may write to the standard output, see 'external_procedures'. *)
+  let flush_printers call =
+    match (try Some (Scope.get scope procedure_id) with Scope.Undefined _ -> None) with
+    | Some defn when List.memq defn !external_procedures ->
+        {call with precall = Code.string "_awe_flush_printers();\n" @$ call.precall}
+    | _ -> 
+        call
+  in
+
+  (* Calls to quiet procedures can pass name parameters directly, see 'direct_procedures'. *)
+  let direct =
+    match (try Some (Scope.get scope procedure_id) with Scope.Undefined _ -> None) with
+    | Some defn when List.mem_assq defn !direct_procedures -> 
+        let direct = List.assq defn !direct_procedures in
+        if direct_call_allowed scope direct.direct_modes formals actuals then Some direct else None
+    | _ -> 
+        None
+  in
 
-  if return_type = Statement then 
-    let ccall = "$($);\n" $$ [Code.id procedure_id; call.args] in
-    if call.decls    = Code.empty && 
-       call.postcall = Code.empty && 
-       call.postcall = Code.empty 
-    then 
-      {t = Statement; c = ccall}
-    else 
-      {t = Statement; c = "{\n$$$$}\n" $$ [call.decls; call.precall; ccall; call.postcall]}
+  let modes = match direct with Some d -> d.direct_modes | None -> List.map (fun _ -> Not_name) formals in
+
+  (* STRING VALUE parameters that can be passed without copying, see 'readonly_string_formals'. *)
+  let readonly =
+    match (try Some (Scope.get scope procedure_id) with Scope.Undefined _ -> None) with
+    | Some defn when List.mem_assq defn !readonly_string_formals -> List.assq defn !readonly_string_formals
+    | _ -> List.map (fun _ -> false) formals
+  in
+
+  (* The C code for each parameter, and the C function arguments separately. *)
+  let add_parameter (call, args) ((var, actual, formal) : Code.t * Tree.t * Type.formal_t) (mode, readonly) =
+    let call = 
+      match formal, mode with
+      | By_name _, Name_by_reference _ -> 
+          {call with args = (designator Pointer scope actual).c}
+      | By_value (String n), _ when readonly && unchangeable_actual scope procedure_id actuals actual n ->
+          {call with args = (expression scope actual).c}
+      | _, _ -> 
+          add_call_parameter scope call (var, actual, direct_formal formal mode)
+    in
+    ({call with args = Code.empty}, args @ [call.args])
+  in
+
+  let call, args = 
+    List.fold_left2 add_parameter (empty_actual_parameters, []) parameter_info (List.combine modes readonly) 
+  in
+  let call = add_tracing (flush_printers {call with args = Code.separate ", " args}) in
+
+  let inlined =
+    match (try Some (Scope.get scope procedure_id) with Scope.Undefined _ -> None) with
+    | Some defn when List.mem_assq defn !inline_procedures && not (List.memq defn !inlining) ->
+        let procedure, declaration_scope = List.assq defn !inline_procedures in
+        if inline_call_allowed procedure declaration_scope scope then
+          Some (inline_call defn procedure declaration_scope modes call args)
+        else 
+          None
+    | _ -> 
+        None
+  in
+
+  let function_id = 
+    match direct, inlined with
+    | Some d, _    -> d.direct_id
+    | None, Some _ -> Code.empty  (* not called *)
+    | None, None   ->
+        match specialized_procedure scope procedure_id formals actuals with
+        | Some c_id -> c_id
+        | None      -> procedure_c_id scope procedure_id
+  in
+
+  (* The hidden destination argument of a procedure that returns a string. The variable
+     of an assignment is only passed if nothing else writes or reads it during the call. *)
+  let in_place =
+    match destination with
+    | Some (variable_id, _) ->
+        let uses_variable = 
+          tree_exists 
+            (function 
+              | Tree.Identifier (_, id) | Tree.Parametrized (_, id, _) -> Id.eq id variable_id 
+              | _ -> false)
+        in
+        call.postcall = Code.empty && not (List.exists uses_variable actuals)
+    | None -> 
+        false
+  in
+  let string_result =
+    match (try Some (Scope.get scope procedure_id) with Scope.Undefined _ -> None) with
+    | Some defn -> List.mem_assq defn !string_result_procedures
+    | None      -> false
+  in
+  (* Otherwise the call has its own result array. *)
+  let own_result =
+    if string_result && not in_place && inlined = None then
+      ( incr string_result_counter ;
+        Some ("_awe_result_$" $$ [code_of_int !string_result_counter]) )
+    else
+      None
+  in
+  let result =
+    match destination, own_result with
+    | Some (_, d), _ when string_result && in_place -> Some d
+    | _, Some buffer                                -> Some ("$.s" $$ [buffer])
+    | _, None                                       -> None
+  in
+  let arguments = match result with Some r -> r @$. call.args | None -> call.args in
+  let in_own_result (fcall : typed_code_t) : typed_code_t =
+    match own_result with
+    | Some buffer ->
+        {fcall with c = "({ struct { unsigned char s[$]; } $; $; $; }).s" 
+                          $$ [sizeof_ctype return_type; buffer; fcall.c; buffer]}
+    | None ->
+        fcall
+  in
+
+  (* Otherwise the assignment's variable is given the result after the call. *)
+  let into_destination (fcall : typed_code_t) : typed_code_t =
+    match destination with
+    | Some (_, d) when not in_place ->
+        {fcall with c = "_awe_string_into($, $, $)" $$ [d; fcall.c; sizeof_ctype return_type]}
+    | _ ->
+        fcall
+  in
+
+  match inlined with
+  | Some code -> 
+      code
+  | None ->
+      if return_type = Statement then 
+        let ccall = "$($);\n" $$ [function_id; call.args] in
+        if call.decls    = Code.empty && 
+           call.precall  = Code.empty && 
+           call.postcall = Code.empty 
+        then 
+          {t = Statement; c = ccall}
+        else 
+          {t = Statement; c = "{\n$$$$}\n" $$ [call.decls; call.precall; ccall; call.postcall]}
 
+      else
+        let fcall = {t = return_type; c = "$($)" $$ [function_id; arguments]} in
+        into_destination (in_own_result
+          ( if call.decls    = Code.empty && 
+               call.precall  = Code.empty && 
+               call.postcall = Code.empty 
+            then 
+              fcall
+            else 
+              if call.postcall = Code.empty && result <> None then
+                {t = return_type; c = "({ $$$; })" $$ [call.decls; call.precall; fcall.c]}
+              else if call.postcall = Code.empty then
+                {t = return_type; c = "({ $$$; })" $$ [call.decls; call.precall; copy_if_string fcall]}
+              else
+                let return_id = "_$_ret" $$ [Code.id procedure_id] in
+                let return_var = {t = return_type; c = return_id} in
+                { t = return_type; 
+                  c = "({ $$$$$$; })" $$ [ call.decls;
+                                           declare_simple return_type return_id;
+                                           call.precall;
+                                           assignment_statement loc return_var fcall;
+                                           call.postcall;
+                                           if own_result <> None then return_id else copy_if_string return_var ] } ))
+
+
+(* 'inline_call defn procedure declaration_scope modes call args' compiles a call to 'procedure' 
+   in place, see 'inline_procedures'. 'call' and 'args' are the C code for its actual 
+   parameters, passed as 'modes' says.
+
+   Declaration:  INTEGER PROCEDURE F (INTEGER VALUE N); N * N + 1;
+   Algol call:   I := F(X)
+   C call:       i = ({ int _f_in1 = x; 
+                        int _f_ret = ({ int n = _f_in1; n * n + 1; }); 
+                        _f_ret; });
+
+   The arguments are put in temporary variables first, in case they use identifiers
+   that the formal parameters hide. *)
+
+and inline_call (defn : Type.definition_t)
+                (procedure : procedure_header_t) 
+                (declaration_scope : Scope.t) 
+                (modes : direct_formal_t list) 
+                (call : actual_parameters_t) 
+                (args : Code.t list) 
+                : typed_code_t =
+  let c_id = Code.id procedure.proc_id in
+  let formals = List.map2 direct_formal procedure.parameters.formal_types modes in
+  let temps = mapi 1 (fun i _ -> "_$_in$" $$ [c_id; code_of_int i]) formals in
+  let declare vars values =
+    Code.concat 
+      (List.map2 
+         (fun (var, formal) value -> "$ = $;\n" $$ [formal_declaration var formal; value]) 
+         (List.combine vars formals) 
+         values)
+  in
+  let arguments = declare temps args in
+  let parameters = declare (List.map Code.id procedure.formal_ids) temps in
+  let body_scope = Scope.push (direct_locals procedure modes :: declaration_scope) in
+  let saved_inlining = !inlining in
+  let saved_warnings = !quiet_warnings in
+  inlining := defn :: saved_inlining ;
+  quiet_warnings := true ;  (* they are given when the procedure's function is compiled *)
+  let body = with_ref_facts [] (fun () -> expression body_scope procedure.body) in
+  inlining := saved_inlining ;
+  quiet_warnings := saved_warnings ;
+  if procedure.returntype = Statement then
+    { t = Statement; 
+      c = "{\n$$${\n$$}\n$}\n" $$ [call.decls; call.precall; arguments; parameters; body.c; call.postcall] }
   else
-    let fcall = {t = return_type; c = "$($)" $$ [Code.id procedure_id; call.args]} in
-    if call.decls    = Code.empty && 
-       call.postcall = Code.empty && 
-       call.postcall = Code.empty 
-    then 
-      fcall
-    else 
-      if call.postcall = Code.empty then
-        {t = return_type; c = "({ $$$; })" $$ [call.decls; call.precall; copy_if_string fcall]}
+    let return_id = "_$_ret" $$ [c_id] in
+    { t = procedure.returntype;
+      c = "({ $$$$ $ = ({ $$; });\n$$; })" $$ 
+            [ call.decls; call.precall; arguments; 
+              ctype procedure.returntype; return_id; 
+              parameters; cast (Tree.to_loc procedure.body) procedure.returntype body; 
+              call.postcall; return_id ] }
+
+
+(* 'specialized_procedure scope procedure_id formals actuals' is the C function of the clone 
+   of 'procedure_id' that a call with 'actuals' can use, see 'specializations'. The clone is 
+   compiled the first time it is needed. *)
+
+and specialized_procedure (scope : Scope.t) 
+                          (procedure_id : Id.t) 
+                          (formals : formal_t list) 
+                          (actuals : Tree.t list) 
+                          : Code.t option =
+  let defn id = try Some (Scope.get scope id) with Scope.Undefined _ -> None in
+  let bound formal actual =
+    match formal, actual with
+    | By_procedure _, Tree.Identifier (_, id) ->
+        ( match defn id with 
+          | Some (Procedure _ as d) when List.mem_assq d !lifted_procedures -> Some d
+          | _ -> None )
+    | _, _ -> 
+        None
+  in
+  let same_binding a b = 
+    match a, b with 
+    | Some a, Some b -> a == b 
+    | None, None -> true 
+    | _, _ -> false
+  in
+  match defn procedure_id with
+  | Some p when !Options.inline_procedures && List.mem_assq p !specializable_procedures ->
+      let key = List.map2 bound formals actuals in
+      let clones = List.map snd (List.filter (fun (d, _) -> d == p) !specializations) in
+      let matching (k, _) = List.for_all2 same_binding key k in
+      if not (List.exists (function Some _ -> true | None -> false) key) then
+        None
+      else if List.exists matching clones then
+        Some (snd (List.find matching clones))
+      else if List.length clones >= specialization_limit then
+        None
       else
-        let return_id = "_$_ret" $$ [Code.id procedure_id] in
-        let return_var = {t = return_type; c = return_id} in
-        { t = return_type; 
-          c = "({ $$$$$$; })" $$ [ call.decls;
-                                   declare_simple return_type return_id;
-                                   call.precall;
-                                   assignment_statement loc return_var fcall;
-                                   call.postcall;
-                                   copy_if_string return_var ] }
+        let procedure, declaration_scope = List.assq p !specializable_procedures in
+        incr specialization_counter ;
+        let c_id = "$_spec$" $$ [procedure_c_id scope procedure_id; code_of_int !specialization_counter] in
+        let header = procedure_c_header procedure c_id in
+        let bind locals (id, binding) =
+          match binding with
+          | Some d -> List.hd (Scope.redefine [locals] id d)
+          | None   -> locals
+        in
+        let locals = 
+          List.fold_left bind procedure.parameters.procedure_locals (List.combine procedure.formal_ids key) 
+        in
+        (* Registered first, so that recursive calls in the body use the clone. *)
+        specializations := (p, (key, c_id)) :: !specializations ;
+        file_scope_code := !file_scope_code @$ ("static $;\n" $$ [header]) ;
+        let saved_warnings = !quiet_warnings in
+        quiet_warnings := true ;  (* they are given when the procedure's function is compiled *)
+        let code = procedure_function declaration_scope procedure header locals in
+        quiet_warnings := saved_warnings ;
+        file_scope_code := !file_scope_code @$ ("static $\n" $$ [code]) ;
+        Some c_id
+  | _ -> 
+      None
+
+
+(* 'direct_call_allowed scope modes formals actuals' is true if a call to a quiet procedure 
+   can use its clone. Each name actual parameter must be:
+
+   - for a read-only name parameter: an expression of the same type with no side effects,
+     which cannot fail unless the parameter is strict;
+
+   - for an assigned name parameter: a variable of the same type, or an element of an 
+     array selected by constants and FOR control identifiers if the parameter is strict. 
+
+   Read-only actual parameters must not use the variables or arrays of assigned ones. *)
+
+and direct_call_allowed (scope : Scope.t) 
+                        (modes : direct_formal_t list) 
+                        (formals : formal_t list) 
+                        (actuals : Tree.t list) 
+                        : bool =
+  let defn id = try Some (Scope.get scope id) with Scope.Undefined _ -> None in
+  let rec pure tree =
+    match tree with
+    | Tree.Integer _ | Tree.Bits _ | Tree.String _ | Tree.Real _ | Tree.Imaginary _
+    | Tree.LongReal _ | Tree.LongImaginary _ | Tree.TRUE _ | Tree.FALSE _ | Tree.NULL _ ->
+        true
+    | Tree.Identifier (_, id) ->
+        ( match defn id with Some (Variable _ | Result _ | Control) -> true | _ -> false )
+    | Tree.Parametrized (_, id, actuals) ->
+        ( match defn id with Some (Array _ | Analysis _ | Field _) -> true | _ -> false )
+        && List.for_all pure actuals
+    | Tree.Binary (_, reference, Tree.IS, _) ->
+        pure reference
+    | Tree.Binary _ | Tree.Unary _ | Tree.Substring _ | Tree.IF_else _ | Tree.CASE_expr _ ->
+        List.for_all pure (Tree.subtrees tree)
+    | _ ->
+        false
+  in
+  let rec identifiers tree =
+    match tree with
+    | Tree.Identifier (_, id) -> [id]
+    | Tree.Parametrized (_, id, actuals) -> id :: List.concat (List.map identifiers actuals)
+    | Tree.Binary (_, reference, Tree.IS, _) -> identifiers reference
+    | _ -> List.concat (List.map identifiers (Tree.subtrees tree))
+  in
+  let cannot_fail tree =
+    match tree with
+    | Tree.Parametrized _ | Tree.Binary _ | Tree.Unary _ | Tree.Substring _ 
+    | Tree.IF_else _ | Tree.CASE_expr _ -> false
+    | _ -> true
+  in
+  let fixed_subscript tree =
+    match tree with
+    | Tree.Integer _ -> true
+    | Tree.Identifier (_, id) -> ( match defn id with Some Control -> true | _ -> false )
+    | _ -> false
+  in
+  let by_value t strict actual =
+    pure actual && (strict || cannot_fail actual) && equal_simple_types t (expression scope actual).t
+  in
+  let by_reference t strict actual =
+    match actual with
+    | Tree.Identifier (_, id) ->
+        ( match defn id with Some (Variable t' | Result t') -> equal_simple_types t t' | _ -> false )
+    | Tree.Parametrized (_, id, subscripts) ->
+        ( match defn id with 
+          | Some (Array (t', n)) -> 
+              strict && equal_simple_types t t' && List.length subscripts = n 
+              && List.for_all fixed_subscript subscripts
+          | _ -> false )
+    | _ -> 
+        false
+  in
+  let parameters = List.combine modes (List.combine formals actuals) in
+  let assigned =
+    List.concat 
+      (List.map 
+         (function 
+           | (Name_by_reference _, (_, actual)) -> identifiers actual 
+           | _ -> [])
+         parameters)
+  in
+  let allowed (mode, (formal, actual)) =
+    match mode, formal with
+    | Name_by_value strict, By_name t -> 
+        by_value t strict actual 
+        && not (List.exists (fun id -> List.exists (Id.eq id) assigned) (identifiers actual))
+    | Name_by_reference strict, By_name t -> 
+        by_reference t strict actual
+    | _ -> 
+        true
+  in
+  List.for_all allowed parameters
 
 
 (* 'add_call_parameter' accumulates C code fragments for procedure parameter pre/post call blocks.
@@ -1480,6 +3099,11 @@ and add_call_parameter (scope : Scope.t)
 
   let loc = Tree.to_loc actual in
 
+  (* With -n, an actual parameter that needs a pointer to a nested function is an error. *)
+  let trampoline_error () =
+    error loc "with -n, this actual parameter would need a nested function and a trampoline"
+  in
+
   match formal with
 
   (* *** Value Actual Parameters  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - *)
@@ -1596,6 +3220,7 @@ and add_call_parameter (scope : Scope.t)
 
   | By_procedure (ftype, []) ->
       let use_thunk () =
+        if !Options.name_closures then trampoline_error () ;
         let procedure_thunk =
           if ftype = Statement then
             "void $(void) { $ }\n" $$ [var; expression_expect Statement scope actual]
@@ -1613,8 +3238,9 @@ and add_call_parameter (scope : Scope.t)
       ( match actual with
       | Tree.Identifier (loc, procedure_id) ->
           ( match get loc scope procedure_id with
-          | Procedure (t, []) when equal_simple_types t ftype -> 
-              {call with args = call.args @$. Code.id procedure_id}
+          | Procedure (t, []) as defn when equal_simple_types t ftype -> 
+              if !Options.name_closures && List.memq defn !nested_procedures then trampoline_error () ;
+              {call with args = call.args @$. procedure_c_id scope procedure_id}
           | _ -> use_thunk()
           )
       | _ -> use_thunk()
@@ -1623,8 +3249,9 @@ and add_call_parameter (scope : Scope.t)
       ( match actual with
       | Tree.Identifier (loc, procedure_id) ->
           ( match get loc scope procedure_id with
-          | Procedure actual_procedure when equal_procedure_types actual_procedure formal_procedure -> 
-              {call with args = call.args @$. Code.id procedure_id}
+          | Procedure actual_procedure as defn when equal_procedure_types actual_procedure formal_procedure -> 
+              if !Options.name_closures && List.memq defn !nested_procedures then trampoline_error () ;
+              {call with args = call.args @$. procedure_c_id scope procedure_id}
           | Procedure actual_procedure  -> 
               error loc "expected %s here, this is %s" 
                 (describe_procedure formal_procedure)
@@ -1665,7 +3292,20 @@ and add_call_parameter (scope : Scope.t)
 
      Declaration:  INTEGER PROCEDURE P(INTEGER N);
      Algol call:   P(X)
-     C call:       p(x); *)
+     C call:       p(x);
+
+     With the -n option the thunks return "void *" and are passed as "_awe_name" 
+     closures. Where possible the thunk is at file scope, see 'name_captures':
+
+     Algol call:   P (A(I))
+     File scope:   struct _awe_thunk_1_env { _awe_array_t *a; int *i; };
+                   static void *_awe_thunk_1 (void *_env) {
+                     struct _awe_thunk_1_env *_e = _env;
+                     _awe_array_t *a = _e->a;
+                     int *i = _e->i;
+                     return a(_awe_HERE, *i); }
+     C call:       { struct _awe_thunk_1_env _p_arg1_env = {a, &i};
+                     p((_awe_name){_awe_thunk_1, &_p_arg1_env}); } *)
 
   | By_name ftype ->
       let name_error kind t =
@@ -1674,7 +3314,8 @@ and add_call_parameter (scope : Scope.t)
           kind
           (describe_simple ftype) 
       in
-      let use_thunk () =
+      let temp_var = "$_temp" $$ [var] in
+      let nested_thunk () =
         match designator_or_expression Pointer scope actual with
         | Designator dcode ->
             if equal_simple_types ftype dcode.t then
@@ -1687,10 +3328,9 @@ and add_call_parameter (scope : Scope.t)
         | Expression ecode ->
             warning loc "Note, this call-by-name parameter is an expression." ;
             if equal_simple_types ftype ecode.t then
-              let temp_var = "$_temp" $$ [var] in
               let expression_thunk = 
                 "$$(void){ $; return $; }\n" 
-                  $$ [ c_pointer_type ftype; var; 
+                  $$ [ c_pointer_type ftype; var;
                        assignment_statement loc {t = ftype; c = temp_var} ecode; 
                        address_of ftype temp_var ]
               in
@@ -1700,6 +3340,85 @@ and add_call_parameter (scope : Scope.t)
             else
               name_error "expression" ecode.t
       in
+      let file_scope_thunk captures =
+        incr name_thunk_counter ;
+        let thunk = "_awe_thunk_$" $$ [code_of_int !name_thunk_counter] in
+        let env_struct = "struct $_env" $$ [thunk] in
+        let env_var = "$_env" $$ [var] in
+        (* For each captured identifier: its C type in the environment, its value 
+           in the caller, and its definition inside the thunk. *)
+        let capture (id, defn) =
+          let c = Code.id id in
+          match defn with
+          | Variable t   -> (c_pointer_type t, c), address_of t c, Result t
+          | Result t     -> (c_pointer_type t, c), c, Result t
+          | Control      -> (Code.string "int ", c), c, Control
+          | Name t       -> (Code.string "_awe_name ", c), c, Name t
+          | Array (t, n) -> (Code.string "_awe_array_t *", c), c, Array (t, n)  (* a new, unfixed array *)
+          | _            -> failwith "Compiler.add_call_parameter: a name thunk cannot capture this"
+        in
+        let captured = List.map capture captures in
+        let thunk_scope =
+          List.fold_left2 
+            (fun s (id, _) (_, _, defn) -> set loc s id defn) 
+            (Scope.push scope) captures captured
+        in
+        let fields = List.map (fun (field, _, _) -> field) captured in
+        let inits  = List.map (fun (_, init, _) -> init) captured in
+        let make_thunk fields inits temp_decl body =
+          let thunk_code, env_arg =
+            match fields with
+            | [] ->
+                "static void *$ (void *_env) {\n$\n}\n\n" $$ [thunk; body],
+                Code.string "0"
+            | _ ->
+                let declare (ctype, c) = "$$;\n" $$ [ctype; c] in
+                let unpack (ctype, c) = "$$ = _e->$;\n" $$ [ctype; c; c] in
+                "$ {\n$};\n\nstatic void *$ (void *_env) {\n$ *_e = _env;\n$$\n}\n\n" 
+                  $$ [ env_struct; Code.concat (List.map declare fields); 
+                       thunk; env_struct; Code.concat (List.map unpack fields); body ],
+                "&$" $$ [env_var]
+          in
+          file_scope_code := !file_scope_code @$ thunk_code ;
+          let env_decl =
+            match fields with
+            | [] -> Code.empty
+            | _  -> "$ $ = {$};\n" $$ [env_struct; env_var; Code.separate ", " inits]
+          in
+          { call with
+              decls = call.decls @$ temp_decl @$ env_decl;
+              args  = call.args @$. ("(_awe_name){$, $}" $$ [thunk; env_arg]) }
+        in
+        match designator_or_expression Pointer thunk_scope actual with
+        | Designator dcode ->
+            if equal_simple_types ftype dcode.t then
+              make_thunk fields inits Code.empty ("return $;" $$ [dcode.c])
+            else
+              name_error "variable" dcode.t
+        | Expression ecode ->
+            warning loc "Note, this call-by-name parameter is an expression." ;
+            if equal_simple_types ftype ecode.t then
+              let temp = 
+                match ftype with 
+                | String n when n > 1 -> Code.string "_temp" 
+                | _                   -> Code.string "*_temp"
+              in
+              make_thunk 
+                (fields @ [(c_pointer_type ftype, Code.string "_temp")])
+                (inits @ [address_of ftype temp_var])
+                (declare_simple ftype temp_var)
+                ("$;\nreturn _temp;" $$ [assignment_statement loc {t = ftype; c = temp} ecode])
+            else
+              name_error "expression" ecode.t
+      in
+      let use_thunk () =
+        if !Options.name_closures then
+          match name_captures scope actual with
+          | Some captures -> file_scope_thunk captures
+          | None          -> trampoline_error ()
+        else
+          nested_thunk ()
+      in
       let pass_name_variable variable_id =
         let defn = get loc scope variable_id in
         match defn with 
@@ -1994,6 +3713,34 @@ and standard_procedure (loc : Location.t) (scope : Scope.t)
           error loc "IOCONTROL expects INTEGER or statement actual parameters, this is %s" s
     in
 
+    let fused_write new_line =
+      let field parameter =
+        let ploc = Tree.to_loc parameter in
+        let pa = expression scope parameter in
+        let kind, length, member =
+          match pa.t with
+          | Number(_, Integer) -> "i", 0, "i"
+          | Number(_, Real)    -> "r", 0, "r"
+          | Number(_, Complex) -> "z", 0, "z"
+          | Logical            -> "l", 0, "i"
+          | Bits               -> "b", 0, "b"
+          | String 1           -> "c", 0, "c"
+          | String length      -> "s", length, "s"
+          | Reference _        -> "p", 0, "ref"
+          | _ -> error ploc "%s cannot be written" (describe_simple pa.t)
+        in
+        ( "{'$', $}" $$ [Code.string kind; code_of_int length],
+          "{.$ = $}" $$ [Code.string member; pa.c] )
+      in
+      let fields, values = List.split (List.map field actuals) in
+      { t = Statement;
+        c = "{ static const _awe_Write_field_t _awe_fields[] = {$};
+               _awe_write_fields($, $, $, _awe_fields, (const _awe_Write_value_t[]){$});
+             }
+            " $$ [ Code.separate ", " fields; code_of_loc loc; Code.string (if new_line then "1" else "0");
+                   code_of_int (List.length actuals); Code.separate ", " values ] }
+    in
+
     let io_block f initial final =
         { t = Statement;
           c = "{ _awe_Editing_t _editing_state;
@@ -2003,7 +3750,11 @@ and standard_procedure (loc : Location.t) (scope : Scope.t)
               " $$ [initial; Code.concat (List.map f actuals); final] }
     in
 
+    let fusable = actuals <> [] && List.for_all (quiet_expression scope) actuals in
+
     match stdproc with
+    | Writeon when fusable -> fused_write false
+    | Write   when fusable -> fused_write true
     | Writeon   -> io_block write     Code.empty Code.empty
     | Write     -> io_block write     ("_awe_iocontrol($, 2);\n" $$ [code_of_loc loc]) Code.empty
     | Writecard -> io_block writecard Code.empty ("_awe_iocontrol($, 2);\n" $$ [code_of_loc loc])
@@ -2039,21 +3790,61 @@ and designator_or_expression (flavour : designator_t)
       ( match get loc scope id with
       | Variable t -> Designator { t = t; c = "$$"   $$ [qualifier Lvalue  t; Code.id id] }
       | Result t   -> Designator { t = t; c = "$$"   $$ [qualifier Pointer t; Code.id id] }
+      | Name t when !Options.name_closures ->
+          Designator { t = t; c = "$_awe_NAME($, $)" $$ [qualifier Pointer t; c_pointer_type t; Code.id id] }
       | Name t     -> Designator { t = t; c = "$$()" $$ [qualifier Pointer t; Code.id id] }
       | _          -> Expression (expression scope tree)
       )
   | Tree.Parametrized (loc, id, actuals) ->  (* i.e. has a parameter list. This might be a designator. *)
       ( match get loc scope id with
-      | Array (etype, ndims) ->
+      | Array (etype, ndims) as defn ->
           if List.length actuals <> ndims then
             error loc "Array '%s' requires %i parameter%s" (Id.to_string id) ndims (if ndims = 0 then "" else "s") ;
-          Designator { t = etype;
-                       c = "$_awe_array_SUB($, $, $, $)" $$
-                             [ qualifier Pointer etype;
-                               code_of_loc loc;
-                               (match etype with String n when n > 1 -> Code.string "unsigned char" | t -> ctype t);
-                               Code.id id;
-                               Code.separate ", " (List.map (expression_expect integer scope) actuals)] }
+          (* Arrays of up to three dimensions have rank-specialized inline subscripting macros. 
+             Subscripts that were bounds checked before a FOR loop are each preceded by 
+             the flag that proves they are in range, see 'hoist_array_checks'. *)
+          let flags = mapi 0 (hoisted_flag scope defn) actuals in
+          let subscripts = List.map (expression_expect integer scope) actuals in
+          let flag_code f = match f with Some flag -> flag | None -> Code.string "0" in
+          let element_ctype = match etype with String n when n > 1 -> Code.string "unsigned char" | t -> ctype t in
+          ( match fixed_array id defn with
+            | Some fixed ->
+                (* Arrays with constant bounds are indexed directly, see 'fixed_arrays'. *)
+                let term k (f, csub) ((lower, upper), stride) =
+                  "(long)_awe_array_fixed_subscript($, $, $, $, $, $) * $" $$
+                    [ code_of_loc loc; code_of_int k; flag_code f; csub; 
+                      code_of_int lower; code_of_int upper; code_of_int stride ]
+                in
+                let terms = 
+                  mapi 0 (fun k (fc, bs) -> term k fc bs)
+                    (List.combine (List.combine flags subscripts) (List.combine fixed.fixed_bounds fixed.strides))
+                in
+                Designator { t = etype;
+                             c = "$_awe_array_FIXED_SUB($, $, $, $ - $)" $$
+                                   [ qualifier Pointer etype;
+                                     element_ctype;
+                                     Code.id id;
+                                     sizeof_ctype etype;
+                                     Code.separate " + " terms;
+                                     code_of_int fixed.fixed_offset ] }
+            | None ->
+                let sub_macro, csubscripts =
+                  if ndims <= 3 && List.exists (function Some _ -> true | None -> false) flags then
+                    let flagged f csub = "$, $" $$ [flag_code f; csub] in
+                    "_awe_array_HOISTED_SUB" ^ string_of_int ndims, List.map2 flagged flags subscripts
+                  else if ndims <= 3 then 
+                    "_awe_array_SUB" ^ string_of_int ndims, subscripts
+                  else 
+                    "_awe_array_SUB", subscripts
+                in
+                Designator { t = etype;
+                             c = "$$($, $, $, $)" $$
+                                   [ qualifier Pointer etype;
+                                     Code.string sub_macro;
+                                     code_of_loc loc;
+                                     element_ctype;
+                                     Code.id id;
+                                     Code.separate ", " csubscripts] } )
       | Field (field_type, field_class) ->
           let field_name = Id.to_string id in
           if List.length actuals <> 1 then
@@ -2063,9 +3854,21 @@ and designator_or_expression (flavour : designator_t)
             let reference = expression scope actual in
             ( match reference.t with
             | Reference class_set when Type.ClassSet.mem field_class class_set ->
+                (* A reference that is known to refer to the field's class, see 'ref_facts', needs 
+                   no checks. A reference that can only refer to the field's class needs only
+                   the NULL and uninitialized reference checks. *)
+                let field_pointer =
+                  if proven_class scope actual field_class then
+                    "_$_unchecked($)" $$ [Code.id id; reference.c]
+                  else if Type.ClassSet.cardinal class_set = 1 then
+                    "_$_unchecked(_awe_ref_not_null($, $, $))" $$ 
+                      [Code.id id; code_of_loc loc; reference.c; c_str_const field_name]
+                  else
+                    "$($, $)" $$ [Code.id id; code_of_loc loc; reference.c]
+                in
                 Designator 
                   { t = field_type; 
-                    c = "$$($, $)" $$ [ qualifier Pointer field_type; Code.id id; code_of_loc loc; reference.c ] }
+                    c = "$$" $$ [ qualifier Pointer field_type; field_pointer ] }
             | Reference _ ->
                 error (Tree.to_loc actual) "%s can never have the field %s" 
                   (describe_simple reference.t) 
@@ -2138,7 +3941,7 @@ and add_declaration (block : block_t) (decl : Tree.t) : block_t =
                 expression_expect integer outside_scope u ) )
           bounds
       in
-      List.fold_left (add_array_declaration loc elttype cbounds) block ids
+      List.fold_left (add_array_declaration loc elttype cbounds (fixed_shape bounds)) block ids
 
   | Tree.PROCEDURE (_, _, _, _, _) as procedure -> 
       add_procedure_declaration procedure block
@@ -2172,10 +3975,10 @@ and add_declaration (block : block_t) (decl : Tree.t) : block_t =
 
    C global scope:  
 
-          Records are tagged with pointers to their classes' names so that 
-          reference assignment compatibility can be checked at runtime. 
-          (See section 7.2.2.) They must be global, so the 'program' function 
-          adds this code.
+          Records are tagged with their class numbers so that reference 
+          assignment compatibility can be checked at runtime (see section 7.2.2),
+          and with pointers to their classes' names for messages. The names 
+          must be global, so the 'program' function adds this code.
 
             static const char * const _awe_class_1_r = "r";
 
@@ -2184,9 +3987,16 @@ and add_declaration (block : block_t) (decl : Tree.t) : block_t =
             struct r {
                 const char *_class;
                 int _number;
+                int _class_number;
                 int i;
             };
 
+          The class's allocation descriptor, with the number and offsets of its
+          REFERENCE fields, which are the only words the garbage collector needs
+          to scan. 'r' has none:
+
+            static _awe_record_class_t _r_allocation = {sizeof(struct r), 0, 0};
+
    block.prototypes: 
                      
        "Reference expression" functions that return pointers to new records. 
@@ -2198,21 +4008,30 @@ and add_declaration (block : block_t) (decl : Tree.t) : block_t =
        One for each field. See section 6.1.2.
 
             auto int * i (_awe_loc loc, void *ref);
+            auto int * _i_unchecked (void *ref);
 
    block.functions:
 
        The function declarations for the above. See 'awe.h'.
 
             struct r * r (_awe_loc loc, int i) {
-                struct r * ref = (struct r * ) _awe_allocate_record(loc, sizeof(struct r));
+                struct r * ref = (struct r * ) _awe_allocate_record_of_class(loc, &_r_allocation);
                 ref->_class = _awe_class_1_r;
                 ref->_number = ++_awe_record_counter;
+                ref->_class_number = 1;
                 ref->i = i;
                 return (void * ) ref;
             }
 
             int * i (_awe_loc loc, void *ref) {
-                _awe_ref_field_check(loc, ref, _awe_class_1_r, "i");
+                _awe_ref_field_check(loc, ref, 1, "i");
+                return &((struct r * )ref)->i;
+            }
+
+       Each field also has an unchecked version, for references that are known
+       to refer to records of the class (see 'ref_facts'):
+
+            int * _i_unchecked (void *ref) {
                 return &((struct r * )ref)->i;
             }
 
@@ -2254,6 +4073,7 @@ and add_record_declaration (loc : Location.t)
     | _ -> failwith "add_record_declaration: record_class not previously defined"
   in
   let class_code = Code.id (Class.to_id record_class) in
+  let class_number = code_of_int (Class.number record_class) in
   let r = Code.id record_id in
   
   (* The types and ids of the record's fields, in order: *)
@@ -2282,12 +4102,27 @@ and add_record_declaration (loc : Location.t)
       let declaration (t, id) = declare_simple t (Code.id id) in
       Code.concat (List.map declaration fields)
     in
+    let references = 
+      List.fold_right (fun (t, id) refs -> match t with Reference _ -> id :: refs | _ -> refs) fields []
+    in
+    let allocation =
+      match references with
+      | [] -> 
+          "static _awe_record_class_t _$_allocation = {sizeof(struct $), 0, 0};\n" $$ [r; r]
+      | _ ->
+          let offset id = "__builtin_offsetof(struct $, $)" $$ [r; Code.id id] in
+          "static const unsigned long _$_references[] = {$};
+           static _awe_record_class_t _$_allocation = {sizeof(struct $), $, _$_references};
+          " $$ [ r; Code.separate ", " (List.map offset references); 
+                 r; r; code_of_int (List.length references); r ]
+    in
     "struct $ {
        const char *_class;
        int _number;
+       int _class_number;
        $
      };
-    " $$ [Code.id record_id; field_declarations]
+     $" $$ [Code.id record_id; field_declarations; allocation]
   in
   let record_prototype =
     let field_arguments = 
@@ -2306,15 +4141,17 @@ and add_record_declaration (loc : Location.t)
       Code.concat (List.map assignment fields)
     in        
     "$ {
-       struct $ *ref = (struct $ *)_awe_allocate_record(loc, sizeof(struct $));
+       struct $ *ref = (struct $ *)_awe_allocate_record_of_class(loc, &_$_allocation);
        ref->_class = $;
        ref->_number = ++_awe_record_counter;
+       ref->_class_number = $;
        $
        return (void *)ref;
      }
     " $$ [ record_prototype;
           r; r; r;
           class_code;
+          class_number;
           field_assignments;
         ]
   in
@@ -2333,14 +4170,22 @@ and add_record_declaration (loc : Location.t)
   let field_prototype t field_id = 
     "$$ (_awe_loc loc, void *ref)" $$ [c_pointer_type t; Code.id field_id] 
   in
+  let unchecked_prototype t field_id = 
+    "$_$_unchecked (void *ref)" $$ [c_pointer_type t; Code.id field_id] 
+  in
   let field_function t field_id prototype = 
     let pointer = address_of t ("((struct $ *)ref)->$" $$ [Code.id record_id; Code.id field_id]) in
     "$ {
        _awe_ref_field_check(loc, ref, $, $);
        return $;
      }
+     $ {
+       return $;
+     }
     " $$ [ prototype; 
-          class_code; c_str_const (Id.to_string field_id);
+          class_number; c_str_const (Id.to_string field_id);
+          pointer;
+          unchecked_prototype t field_id;
           pointer ]
   in
   let add_field (block : block_t) (field_decl : Tree.t) : block_t = 
@@ -2353,7 +4198,7 @@ and add_record_declaration (loc : Location.t)
               let f = field_function t field_id p in
               { block'' with
                   scope = set loc block''.scope field_id (Field (t, record_class));
-                  prototypes = ("$auto $;\n" $$ [block''.prototypes; p]);
+                  prototypes = ("$auto $;\nauto $;\n" $$ [block''.prototypes; p; unchecked_prototype t field_id]);
                   functions = block''.functions @$ f } )
           block
           field_ids
@@ -2411,8 +4256,7 @@ and add_procedure_declaration (procedure : Tree.t) (block : block_t) : block_t
               else
                 h, "extern $;\n#define $ $\n" $$ [h; Code.id id; Code.string reference]
         | _ -> 
-            let h = c_header (Code.id id) in
-            h, "auto $;\n" $$ [h]
+            c_header (Code.id id), Code.empty  (* declared by 'add_procedure_functions' *)
       in
       (
         ( match procedure_body with
@@ -2428,11 +4272,16 @@ and add_procedure_declaration (procedure : Tree.t) (block : block_t) : block_t
             proc_id    = id;
             proc_loc   = loc;
             parameters = parameters; 
+            formal_ids = List.concat (List.map formal_segment_ids formal_trees);
             header     = header;
             body       = procedure_body } (* to be defined later, in the complete block scope *)
         in
+        let scope = set loc block.scope id (Procedure (returntype, parameters.formal_types)) in
+        ( match procedure_body with
+          | Tree.External (_, _) -> external_procedures := Scope.get scope id :: !external_procedures
+          | _ -> () ) ;
         { block with
-            scope      = set loc block.scope id (Procedure (returntype, parameters.formal_types));
+            scope      = scope;
             prototypes = block.prototypes @$ prototype;
             procedures = block.procedures @ [proc]
         }
@@ -2440,36 +4289,169 @@ and add_procedure_declaration (procedure : Tree.t) (block : block_t) : block_t
   | _ -> failwith ("Compiler.add_procedure_declaration: not a procedure: " ^ (Tree.str procedure))
 
 
+(* 'procedure_function scope procedure header procedure_locals' is the C function for 'procedure', 
+   declared in 'scope', with 'procedure_locals' as the definitions of its formal parameters. *)
+
+and procedure_function (scope : Scope.t) 
+                       (procedure : procedure_header_t) 
+                       (header : Code.t) 
+                       (procedure_locals : Scope.Local.t) 
+                       : Code.t =
+  let tracer () =
+    if !Options.add_tracing_hooks then
+      "_awe_trace_procedure_entered($, $);\n" $$ [ code_of_loc procedure.proc_loc; 
+                                                  c_str_const (Table.Id.to_string procedure.proc_id)]
+    else Code.empty
+  in
+  let loc = Tree.to_loc procedure.body in
+  let procedure_parameter_scope = procedure_locals :: scope in
+  let procedure_body_scope = Scope.push procedure_parameter_scope in
+  let result = has_string_result procedure in
+  ( match procedure.returntype, procedure.body with
+    | String n, Tree.BEGIN _ when result -> block_destination := Some (Code.string "_awe_result", n)
+    | _, _ -> () ) ;
+  let body = with_ref_facts [] (fun () -> expression procedure_body_scope procedure.body) in
+  block_destination := None ;
+  if body.t <> Statement && result then
+    "$ {$\nreturn _awe_string_into(_awe_result, $, $);\n }\n" $$ 
+      [header; tracer(); cast loc procedure.returntype body; sizeof_ctype procedure.returntype] 
+  else if body.t <> Statement then 
+    "$ {$\nreturn $;\n }\n" $$ [header; tracer(); cast loc procedure.returntype body] 
+  else if procedure.returntype = Statement then
+    "$ {$\n$ }\n" $$ [header; tracer(); body.c]
+  else
+    error loc "this procedure should return %s, but this is a statement" 
+      (describe_simple procedure.returntype)
+
+
 (* This adds C function declarations for Algol procedures to a block.
     It works from the procedure definitions in 'block.procedures', gathered by  
    'add_procedure_declaration' above.) *)
 
-and add_procedure_functions (block : block_t) : block_t =
+and add_procedure_functions (block : block_t) (block_trees : Tree.t list) : block_t =
+  let function_code = procedure_function block.scope in
+  (* Procedures in the outermost scope are separately compiled ones, they keep their names. *)
+  let separately_compiled = List.length block.scope = List.length Predeclared.scope in
+  let passed = List.concat (List.map actual_identifiers block_trees) in
+  let add_string_result procedure =
+    match procedure.returntype, procedure.body with
+    | String n, body when n > 1 && not separately_compiled ->
+        ( match body with
+          | Tree.External (_, _) -> ()
+          | _ when List.exists (Id.eq procedure.proc_id) passed -> ()
+          | _ ->
+              let defn = get procedure.proc_loc block.scope procedure.proc_id in
+              string_result_procedures := (defn, procedure) :: !string_result_procedures )
+    | _, _ -> 
+        ()
+  in
+  List.iter add_string_result block.procedures ;
+  let add_readonly_formals procedure =
+    match procedure.body with
+    | Tree.External (_, _) -> ()
+    | _ ->
+        let defn = get procedure.proc_loc block.scope procedure.proc_id in
+        let scope = procedure.parameters.procedure_locals :: block.scope in
+        readonly_string_formals := (defn, readonly_formals scope procedure) :: !readonly_string_formals
+  in
+  List.iter add_readonly_formals block.procedures ;
+  let lifted = if separately_compiled then [] else liftable_procedures block.scope block.procedures in
+  let is_lifted procedure = List.memq procedure lifted in
+  let lift procedure =
+    incr lifted_procedure_counter ;
+    let c_id = "_awe_proc_$_$" $$ [code_of_int !lifted_procedure_counter; Code.id procedure.proc_id] in
+    let defn = get procedure.proc_loc block.scope procedure.proc_id in
+    lifted_procedures := (defn, c_id) :: !lifted_procedures ;
+    specializable_procedures := (defn, (procedure, block.scope)) :: !specializable_procedures
+  in
+  List.iter lift lifted ;
+  let keep_nested procedure =
+    match procedure.body with
+    | Tree.External (_, _) -> ()
+    | _ when separately_compiled || is_lifted procedure -> ()
+    | _ -> nested_procedures := get procedure.proc_loc block.scope procedure.proc_id :: !nested_procedures
+  in
+  List.iter keep_nested block.procedures ;
+  let header = procedure_c_header in
+  (* Nested functions are declared at the top of their block, lifted ones at file scope. *)
+  let declare (procedure : procedure_header_t) (block : block_t) (header : Code.t) : block_t =
+    if is_lifted procedure then
+      ( file_scope_code := !file_scope_code @$ ("static $;\n" $$ [header]) ; block )
+    else
+      { block with prototypes = block.prototypes @$ ("auto $;\n" $$ [header]) }
+  in
+  let define (procedure : procedure_header_t) (block : block_t) (code : Code.t) : block_t =
+    if is_lifted procedure then
+      ( file_scope_code := !file_scope_code @$ ("static $\n" $$ [code]) ; block )
+    else
+      { block with functions = block.functions @$ code }
+  in
+  let add_prototype (block : block_t) (procedure : procedure_header_t) : block_t =
+    match procedure.body with
+    | Tree.External (_, _) -> block  (* declared by 'add_procedure_declaration' *)
+    | _ -> declare procedure block (header procedure (procedure_c_id block.scope procedure.proc_id))
+  in
+  (* The header and formal parameters of the clone of a quiet procedure, see 'direct_procedures'. *)
+  let direct_function (procedure : procedure_header_t) (direct : direct_procedure_t) =
+    let formals = procedure.parameters.formal_types in
+    let arguments = 
+      List.map2 formal_declaration 
+        (List.map Code.id procedure.formal_ids) 
+        (List.map2 direct_formal formals direct.direct_modes)
+    in
+    let arguments = 
+      if has_string_result procedure then Code.string "_awe_str _awe_result" :: arguments else arguments 
+    in
+    ( "$ $ ($)" $$ [ctype procedure.returntype; direct.direct_id; Code.separate ", " arguments],
+      direct_locals procedure direct.direct_modes )
+  in
+  let add_direct (block : block_t) (procedure : procedure_header_t) : block_t =
+    match procedure.body with
+    | Tree.External (_, _) -> block
+    | _ ->
+        let procedure_parameter_scope = procedure.parameters.procedure_locals :: block.scope in
+        match direct_formal_modes procedure_parameter_scope procedure.formal_ids 
+                                  procedure.parameters.formal_types procedure.body with
+        | Some modes ->
+            let direct_id = 
+              if is_lifted procedure then "$_direct" $$ [procedure_c_id block.scope procedure.proc_id]
+              else "_$_direct" $$ [Code.id procedure.proc_id]
+            in
+            let direct = { direct_id = direct_id; direct_modes = modes } in
+            let header, _ = direct_function procedure direct in
+            let defn = get procedure.proc_loc block.scope procedure.proc_id in
+            direct_procedures := (defn, direct) :: !direct_procedures ;
+            declare procedure block header
+        | None -> 
+            block
+  in
   let add_function (block : block_t) (procedure : procedure_header_t) : block_t =
     match procedure.body with 
     | Tree.External (_, _) ->  block  (* External reference procedures are prototypes only. See section 5.3.2.4. *)
     | _ ->
-        let tracer () =
-          if !Options.add_tracing_hooks then
-            "_awe_trace_procedure_entered($, $);\n" $$ [ code_of_loc procedure.proc_loc; 
-                                                        c_str_const (Table.Id.to_string procedure.proc_id)]
-          else Code.empty
-        in
-        let function_code = 
-          let loc = Tree.to_loc procedure.body in
-          let procedure_parameter_scope = procedure.parameters.procedure_locals :: block.scope in
-          let procedure_body_scope = Scope.push procedure_parameter_scope in
-          let body = expression procedure_body_scope procedure.body in
-          if body.t <> Statement then 
-            "$ {$\nreturn $;\n }\n" $$ [procedure.header; tracer(); cast loc procedure.returntype body] 
-          else if procedure.returntype = Statement then
-            "$ {$\n$ }\n" $$ [procedure.header; tracer(); body.c]
-          else
-            error loc "this procedure should return %s, but this is a statement" 
-              (describe_simple procedure.returntype)
-        in
-        { block with functions = block.functions @$ function_code }
+        let c_header = header procedure (procedure_c_id block.scope procedure.proc_id) in
+        let code = function_code procedure c_header procedure.parameters.procedure_locals in
+        let defn = get procedure.proc_loc block.scope procedure.proc_id in
+        let block = define procedure block code in
+        if List.mem_assq defn !direct_procedures then
+          (* The body is compiled a second time, its warnings have been given already. *)
+          let direct_header, locals = direct_function procedure (List.assq defn !direct_procedures) in
+          let saved = !quiet_warnings in
+          quiet_warnings := true ;
+          let direct_code = function_code procedure direct_header locals in
+          quiet_warnings := saved ;
+          define procedure block direct_code
+        else
+          block
+  in
+  let add_inline (procedure : procedure_header_t) =
+    if inlinable procedure then
+      let defn = get procedure.proc_loc block.scope procedure.proc_id in
+      inline_procedures := (defn, (procedure, block.scope)) :: !inline_procedures
   in
+  List.iter add_inline block.procedures ;
+  let block = List.fold_left add_prototype block block.procedures in
+  let block = List.fold_left add_direct block block.procedures in
   List.fold_left add_function block block.procedures
 
 
@@ -2558,7 +4540,9 @@ and add_formal_segment (scope : Scope.t) (formals : formal_parameters_t) (segmen
         ( fun f id -> 
             { procedure_locals = set_local loc f.procedure_locals id (Name t);
               formal_types     = f.formal_types @ [By_name t];
-              arguments        = f.arguments @$. ("$($$)(void)" $$ [c_pointer_type t; pointer_qualifier t; Code.id id]) } )
+              arguments        = f.arguments @$. 
+                                   ( if !Options.name_closures then "_awe_name $" $$ [Code.id id]
+                                     else "$($$)(void)" $$ [c_pointer_type t; pointer_qualifier t; Code.id id] ) } )
         formals
         ids
   | Tree.ARRAY_formal (loc, t, ids, ndims) ->
@@ -2615,11 +4599,22 @@ and add_label_declarations (block : block_t) (block_body : Tree.t list) : block_
 
        _awe_array_bounds _a_bounds[] = {{x - 2, x + 2}, {0, 2 * x + 1}};
 
-   block.variables: this macro declares a block of memory and an array descriptor
-                    on the stack. The bounds are checked when the descriptor is
-                    initialized.
+   block.variables: this macro declares an array descriptor on the stack and storage
+                    for the elements, which will be on the stack only if the array is
+                    small. The bounds are checked when the descriptor is initialized.
+                    The last argument is 1 if the elements are references, which the
+                    garbage collector has to scan.
+
+       _awe_array_DECLARE(awe_loc(<location>), a, sizeof(void* ), 2, _a_bounds, 1);
 
-       _awe_array_DECLARE(awe_loc(<location>), a, sizeof(void* ), 2, _a_bounds);
+                    If all of the bounds are constants, as in 'REAL ARRAY B (1::10, 0::4)',
+                    the descriptor is given constant multipliers instead, and the array's
+                    shape is recorded in 'fixed_arrays' so that its elements can be
+                    indexed directly. The last arguments are the number of elements,
+                    the total offset in elements and the multipliers:
+
+       _awe_array_DECLARE_FIXED(awe_loc(<location>), b, sizeof(double), 2, _b_bounds, 0,
+                                50, 5, 5 * sizeof(double), 1 * sizeof(double));
 
    block.initialization: Initialization of array elements. Arrays of references are 
                          initialized with _awe_uninitialized_reference, for runtime 
@@ -2632,22 +4627,43 @@ and add_label_declarations (block : block_t) (block_body : Tree.t list) : block_
 and add_array_declaration (loc     : Location.t)
                           (elttype : simple_t) 
                           (bounds  : (Code.t * Code.t) list) 
+                          (shape   : fixed_array_t option)
                           (block   : block_t)
                           (id      : Id.t) 
                           : block_t =
 
+  let definition = Array (elttype, List.length bounds) in
+
   let initialize_bounds =
     let bound_pair (cl, cu) = "{$, $}" $$ [cl; cu] in
     "_awe_array_bound_t _$_bounds[] = {$};\n" $$ [Code.id id; Code.separate ", " (List.map bound_pair bounds)]
   in
   
+  let pointers = code_of_int (match elttype with Reference _ -> 1 | _ -> 0) in
+
   let array_variable =
-    " _awe_array_DECLARE($, $, $, $, _$_bounds);\n" $$
-      [ code_of_loc loc;
-        Code.id id;
-        sizeof_ctype elttype;
-        code_of_int (List.length bounds);
-        Code.id id ]
+    match shape with
+    | Some fixed ->
+        add_fixed_array id definition fixed;
+        let multiplier stride = "$ * $" $$ [code_of_int stride; sizeof_ctype elttype] in
+        " _awe_array_DECLARE_FIXED($, $, $, $, _$_bounds, $, $, $, $);\n" $$
+          [ code_of_loc loc;
+            Code.id id;
+            sizeof_ctype elttype;
+            code_of_int (List.length bounds);
+            Code.id id;
+            pointers;
+            code_of_int fixed.nelements;
+            code_of_int fixed.fixed_offset;
+            Code.separate ", " (List.map multiplier fixed.strides) ]
+    | None ->
+        " _awe_array_DECLARE($, $, $, $, _$_bounds, $);\n" $$
+          [ code_of_loc loc;
+            Code.id id;
+            sizeof_ctype elttype;
+            code_of_int (List.length bounds);
+            Code.id id;
+            pointers ]
   in
 
   let element_initialization =
@@ -2655,7 +4671,7 @@ and add_array_declaration (loc     : Location.t)
       | Reference _ ->
          "_awe_array_FILL(void*, $, _awe_uninitialized_reference);\n" $$ [Code.id id]
       | String n when n > 1 && !Options.initialize_all ->
-         "_awe_array_FILL_WITH_SPACES($)" $$ [Code.id id]
+         "_awe_array_FILL_WITH_SPACES($);\n" $$ [Code.id id]
       | _ when !Options.initialize_all ->
          "_awe_array_FILL($, $, $);\n" $$ [ctype elttype; Code.id id; default elttype]
       | _ ->
@@ -2663,7 +4679,7 @@ and add_array_declaration (loc     : Location.t)
   in
   
   { block with
-      scope          = set loc block.scope id (Array (elttype, List.length bounds)); 
+      scope          = set loc block.scope id definition; 
       outsidescope   = block.outsidescope   @$ initialize_bounds;
       variables      = block.variables      @$ array_variable;
       initialization = block.initialization @$ element_initialization }
@@ -2,3 +2,5 @@
 
 let initialize_all = ref false
 let add_tracing_hooks = ref false
+let name_closures = ref false
+let inline_procedures = ref false
@@ -210,6 +210,59 @@ f.write(MESSAGE)
 f.write(c_code)
 f.close()
 
+# Output the classes of the characters that states loop on to scanner-loops.inc.
+# The scanner skips or copies runs of these characters without going through 
+# the state machine for each one. A loop's characters are copied if its action 
+# is the default action, and skipped if it has no action.
+
+CHAR = r"'(\\x[0-9A-Fa-f]{2}|\\.|[^\\'])'"
+CASE_LABEL = re.compile(r"case %s(?: \.\.\. %s)?:" % (CHAR, CHAR))
+
+def characters(condition):
+    "The character codes in the case labels of a condition. (EOF is not a character.)"
+    codes = set()
+    for m in CASE_LABEL.finditer(condition):
+        first = ord(m.group(1).decode('string_escape'))
+        last = ord(m.group(2).decode('string_escape')) if m.group(2) else first
+        codes.update(range(first, last + 1))
+    return codes
+
+loops = {}
+for state in transitions:
+    for c, next, action in transitions[state]:
+        if next == state and action in (default_action, ';'):
+            keep = action == default_action
+            codes, previous_keep = loops.get(state, ([], keep))
+            assert keep == previous_keep, "state %s both skips and copies characters" % state
+            loops[state] = (codes + [c], keep)
+
+class_codes = sorted(set(c for codes, keep in loops.values() for c in codes))
+assert len(class_codes) <= 8, "too many character classes for an unsigned char"
+class_bit = dict((c, 1 << i) for i, c in enumerate(class_codes))
+
+classes = [0] * 256
+for c in class_codes:
+    for code in characters(conditions[c]):
+        classes[code] |= class_bit[c]
+
+f = open('scanner-loops.inc', 'w')
+f.write(MESSAGE)
+f.write('\n/* Character classes: %s */\n\n' % ', '.join("'%s' = 0x%02X" % (c, class_bit[c]) for c in class_codes))
+f.write('static const unsigned char Scanner_class[256] = {\n')
+for i in range(0, 256, 16):
+    f.write('  %s,\n' % ', '.join('0x%02X' % n for n in classes[i:i + 16]))
+f.write('};\n\n')
+f.write('/* The classes of the characters that a state loops on, and whether it keeps them. */\n\n')
+f.write('static inline int\nScanner_loop (int state, bool *keep)\n{\n  switch (state) {\n')
+for state in sorted(loops.keys(), key=int):
+    codes, keep = loops[state]
+    mask = 0
+    for c in codes:
+        mask |= class_bit[c]
+    f.write('  case %s: *keep = %s; return 0x%02X;\n' % (state, 'true' if keep else 'false', mask))
+f.write('  default: return 0;\n  }\n}\n')
+f.close()
+
 # Output a "dot file" that can be used to visualize the state machine with GraphViz.
 def escape(s): return s.decode('string_escape').replace('"', '\\"')
 f = open("scanner.dot", 'w')
@@ -382,4 +382,28 @@ let rec to_loc : t -> Location.t =
   | symbol -> failwith (sprintf "Tree.to_loc: %s has no location" (str symbol))
 
 
+(* The immediate subtrees of a tree. Operators and simple types are not included. *)
+
+let subtrees : t -> t list =
+  function
+  | IF_else (_, a, b, c) -> [a; b; c]
+  | IF (_, a, b) -> [a; b]
+  | CASE (_, a, bs) -> a :: bs
+  | CASE_expr (_, a, bs) -> a :: bs
+  | WHILE (_, a, b) -> [a; b]
+  | FOR (_, _, a, b, c) -> [a; b; c]
+  | FOR_step (_, _, a, b, c, d) -> [a; b; c; d]
+  | FOR_list (_, _, es, b) -> es @ [b]
+  | ASSERT (_, a) -> [a]
+  | BEGIN (_, ds, ss, _) -> ds @ ss
+  | Assignment (_, a, b) -> [a; b]
+  | Parametrized (_, _, es) -> es
+  | Substring (_, a, b, _) -> [a; b]
+  | Binary (_, a, _, b) -> [a; b]
+  | Unary (_, _, a) -> [a]
+  | ARRAY (_, _, _, bounds) -> List.concat (List.map (fun (l, u) -> [l; u]) bounds)
+  | PROCEDURE (_, _, _, formals, body) -> formals @ [body]
+  | _ -> []
+
+
 (* end *)
@@ -123,4 +123,6 @@ val str : t -> string                 (* Convert a tree back to Algol W. Mostly
 
 val str_of_header : t option -> id -> t list -> string  (* Convert the tree for a procedure header back to Algol W. *)
 
+val subtrees : t -> t list            (* The immediate subtrees of a tree, in source order. Used by the compiler's analyses. *)
+
 (* end *)